@@ -0,0 +1,115 @@
+// Compares the CharTable searches with a plain walk over the same table and with std::string,
+// on the inputs the request parser sees. Built and run by make bench
+#include <sys/time.h>
+
+#include <cstdio>
+#include <string>
+
+#include "CharTable.hpp"
+
+// Same classes as HttpRequest
+static const std::string URI_CHARACTERS = "ABCDEFGHIJKLMNOPQRSTUVXWYZabcdefghijklmnopqrstuvxwyz0123456789-_.~/?:@&=+$,#";
+static const std::string HEADER_VALUE_CHARACTERS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-!@#$%^&*()_+|~=`{}[];:'\",.<>/? \t";
+static const std::string HEADER_KEY_CHARACTERS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-";
+
+static const size_t TARGET_BYTES = 400 * 1000 * 1000;
+
+static long long getTimeMicros() {
+    struct timeval time;
+    gettimeofday(&time, NULL);
+    return (time.tv_sec * 1000000LL + time.tv_usec);
+}
+
+static size_t scalarFind(const CharTable &table, const std::string &str, size_t pos) {
+    for (; pos < str.size(); ++pos) {
+        if (table.contains(str[pos])) {
+            return (pos);
+        }
+    }
+    return (std::string::npos);
+}
+
+static size_t scalarFindFirstNotOf(const CharTable &table, const std::string &str, size_t pos) {
+    for (; pos < str.size(); ++pos) {
+        if (!table.contains(str[pos])) {
+            return (pos);
+        }
+    }
+    return (std::string::npos);
+}
+
+enum Method {
+    METHOD_STRING,
+    METHOD_SCALAR,
+    METHOD_VECTOR,
+};
+
+// Walks every match of the input, the way the parser walks lines or checks a whole field
+static size_t scan(Method method, bool notOf, const CharTable &table, const std::string &set, const std::string &input) {
+    size_t sum = 0;
+    size_t pos = 0;
+    while (pos < input.size()) {
+        size_t found;
+        if (method == METHOD_STRING) {
+            found = notOf ? input.find_first_not_of(set, pos) : input.find_first_of(set, pos);
+        } else if (method == METHOD_SCALAR) {
+            found = notOf ? scalarFindFirstNotOf(table, input, pos) : scalarFind(table, input, pos);
+        } else {
+            found = notOf ? table.findFirstNotOf(input, pos) : table.find(input, pos);
+        }
+        if (found == std::string::npos) {
+            break;
+        }
+        sum += found;
+        pos = found + 1;
+    }
+    return (sum);
+}
+
+static bool run(const char *name, bool notOf, const std::string &set, const std::string &input) {
+    static const char *methodNames[] = {"std::string", "table loop", "CharTable"};
+
+    CharTable table(set);
+    size_t iterations = TARGET_BYTES / input.size() + 1;
+    size_t expected = scan(METHOD_SCALAR, notOf, table, set, input);
+    double nanos[3];
+    for (int method = METHOD_STRING; method <= METHOD_VECTOR; ++method) {
+        if (scan(static_cast<Method>(method), notOf, table, set, input) != expected) {
+            std::printf("%-34s %s disagrees with the table loop\n", name, methodNames[method]);
+            return (false);
+        }
+        size_t sink = 0;
+        long long start = getTimeMicros();
+        for (size_t i = 0; i < iterations; ++i) {
+            sink += scan(static_cast<Method>(method), notOf, table, set, input);
+        }
+        nanos[method] = (getTimeMicros() - start) * 1000.0 / iterations;
+        if (sink == 1) {
+            std::printf(" ");
+        }
+    }
+    std::printf("%-34s %6lu B %10.1f %10.1f %10.1f %8.1fx\n", name, static_cast<unsigned long>(input.size()), nanos[METHOD_STRING], nanos[METHOD_SCALAR], nanos[METHOD_VECTOR], nanos[METHOD_SCALAR] / nanos[METHOD_VECTOR]);
+    return (true);
+}
+
+int main() {
+    std::string request = "GET /index.html HTTP/1.1\r\nHost: localhost:8080\r\nUser-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\nAccept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\nAccept-Encoding: gzip, deflate, br\r\nAccept-Language: en-US,en;q=0.9\r\nCookie: session=abcdef0123456789; theme=dark; lang=en\r\nConnection: keep-alive\r\n\r\n";
+    std::string shortLines = "GET / HTTP/1.1\r\nHost: a\r\nX: 1\r\nY: 2\r\nZ: 3\r\n\r\n";
+    std::string longCookie = "GET / HTTP/1.1\r\nHost: a\r\nCookie: " + std::string(4000, 'c') + "\r\n\r\n";
+    std::string userAgent = "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36";
+    std::string cookieValue = "session=abcdef0123456789; theme=dark; lang=en; " + std::string(4000, 'c');
+    std::string key = "Accept-Language";
+    std::string uri = "/static/assets/images/thumbnails/2024/07/holiday-photo-0001.jpg?size=large&format=webp";
+
+    std::printf("ns per scan of the input                     std::string table loop  CharTable  speedup\n");
+    bool ok = true;
+    ok = run("find CR, browser request", false, "\r", request) && ok;
+    ok = run("find CR, short lines", false, "\r", shortLines) && ok;
+    ok = run("find CR, 4 KB cookie", false, "\r", longCookie) && ok;
+    ok = run("find SP CR LF, browser request", false, " \r\n", request) && ok;
+    ok = run("validate header value, user agent", true, HEADER_VALUE_CHARACTERS, userAgent) && ok;
+    ok = run("validate header value, 4 KB cookie", true, HEADER_VALUE_CHARACTERS, cookieValue) && ok;
+    ok = run("validate header key", true, HEADER_KEY_CHARACTERS, key) && ok;
+    ok = run("validate uri", true, URI_CHARACTERS, uri) && ok;
+    return (ok ? 0 : 1);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+// The expires and cache_control directives of a server or location
+class CachePolicy {
+   public:
+    static const std::string EXPIRES_KEY;
+    static const std::string CACHE_CONTROL_KEY;
+    static const long MAX_EXPIRES;
+
+    CachePolicy();
+    CachePolicy(const CachePolicy& other);
+    CachePolicy& operator=(const CachePolicy& other);
+    ~CachePolicy();
+
+    static bool isDirective(const std::string& key);
+    // False when the values are not valid for the directive
+    bool set(const std::string& key, const std::vector<std::string>& values);
+
+    bool isConfigured() const;
+    // Cache-Control and Expires for a response, nothing when no policy is set
+    void addHeaders(std::map<std::string, std::string>& headers) const;
+
+   private:
+    enum Expiry {
+        EXPIRES_OFF,
+        EXPIRES_EPOCH,
+        EXPIRES_AFTER,
+    };
+
+    bool configured;
+    Expiry expiry;
+    long maxAge;
+    std::string cacheControl;
+
+    static bool parseDuration(const std::string& value, long& seconds);
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+// A page the server renders itself, its gzip form is kept beside it once a response asked for one
+struct GeneratedPage {
+    std::string content;
+    // One per level asked for, empty when it wasn't smaller than the content. A form is never
+    // changed once made, so a response can send it without copying it
+    mutable std::map<int, std::string> gzipContents;
+
+    GeneratedPage();
+    GeneratedPage(const std::string& content);
+};
+
+// The gzip directives of a server or location
+class Compression {
+   public:
+    static const std::string GZIP_KEY;
+    static const std::string GZIP_STATIC_KEY;
+    static const std::string GZIP_COMP_LEVEL_KEY;
+    static const std::string GZIP_MIN_LENGTH_KEY;
+    static const int DEFAULT_LEVEL;
+    static const size_t DEFAULT_MIN_LENGTH;
+
+    Compression();
+    Compression(const Compression& other);
+    Compression& operator=(const Compression& other);
+    ~Compression();
+
+    static bool isDirective(const std::string& key);
+    // False when the value is not valid for the directive
+    bool set(const std::string& key, const std::string& value);
+
+    bool isConfigured() const;
+    bool isEnabled() const;
+    bool isStaticEnabled() const;
+    int getLevel() const;
+    size_t getMinLength() const;
+    // Whether a body of this type and size is worth compressing on the fly
+    bool shouldCompress(const std::string& mimeType, size_t size) const;
+    static bool isCompressible(const std::string& mimeType);
+    // The gzip form of the page at this level, made on the first call, NULL when it isn't smaller
+    const std::string* getGzip(const GeneratedPage& page) const;
+
+   private:
+    bool configured;
+    bool enabled;
+    bool staticEnabled;
+    int level;
+    size_t minLength;
+};
@@ -4,12 +4,14 @@
 #include <string>
 #include <vector>
 
+#include "CachePolicy.hpp"
+#include "Compression.hpp"
 #include "Method.hpp"
 
 class Configurations {
    public:
     Configurations();
-    Configurations(bool isAutoindex, size_t clientBodySize, const std::string& redirect, const std::string& root, const std::string& index, const std::vector<Method>& methods, const std::vector<std::pair<size_t, std::string> >& errorPages, const std::map<std::string, std::string>& cgiPaths);
+    Configurations(bool isAutoindex, size_t clientBodySize, const std::string& redirect, const std::string& root, const std::string& index, const std::vector<Method>& methods, const std::vector<std::pair<size_t, std::string> >& errorPages, const std::map<std::string, std::string>& cgiPaths, const std::string& fastCgiPass, const Compression& compression, const CachePolicy& cachePolicy);
     Configurations(const Configurations& other);
     Configurations& operator=(const Configurations& other);
     ~Configurations();
@@ -20,8 +22,12 @@ class Configurations {
     const std::string& getRoot() const;
     const std::string& getIndex() const;
     const std::vector<Method>& getMethods() const;
-    const std::vector<std::pair<size_t, std::string> >& getErrorPages() const;
+    // The content of each error_page file by status, read once when the configuration is built
+    const std::map<size_t, GeneratedPage>& getErrorPages() const;
     const std::map<std::string, std::string>& getCgiPaths() const;
+    const std::string& getFastCgiPass() const;
+    const Compression& getCompression() const;
+    const CachePolicy& getCachePolicy() const;
 
    private:
     bool isAutoindex;
@@ -30,6 +36,11 @@ class Configurations {
     std::string root;
     std::string index;
     std::vector<Method> methods;
-    std::vector<std::pair<size_t, std::string> > errorPages;
+    std::map<size_t, GeneratedPage> errorPages;
     std::map<std::string, std::string> cgiPaths;
+    std::string fastCgiPass;
+    Compression compression;
+    CachePolicy cachePolicy;
+
+    void loadErrorPages(const std::vector<std::pair<size_t, std::string> >& errorPagePaths);
 };
@@ -11,6 +11,10 @@
 class Config {
    public:
     static const std::string SERVER_KEY;
+    static const std::string EVENT_BACKEND_KEY;
+    static const std::string WORKER_PROCESSES_KEY;
+    static const std::string WORKER_CPU_AFFINITY_KEY;
+    static const size_t MAX_WORKER_PROCESSES;
 
     Config();
     Config(const Config &other);
@@ -20,15 +24,24 @@ class Config {
     void loadConfig(std::string configFilePath);
 
     const std::vector<ServerConfig> &getServers() const;
+    const std::string &getEventBackend() const;
+    size_t getWorkerProcesses() const;
+    bool getWorkerCpuAffinity() const;
 
    private:
     Logger logger;
     AstNode rootAstNode;
     std::vector<Token> tokens;
     std::vector<ServerConfig> servers;
+    std::string eventBackend;
+    size_t workerProcesses;
+    bool workerCpuAffinity;
 
     void tokenize(const std::string &fileString);
     void verifyBrackets();
     void parseConfigToAst(AstNode *parentBlock);
     void parseServers();
+    void parseEventBackend(const AstNode &node);
+    void parseWorkerProcesses(const AstNode &node);
+    void parseWorkerCpuAffinity(const AstNode &node);
 };
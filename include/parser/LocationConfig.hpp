@@ -5,6 +5,8 @@
 #include <vector>
 
 #include "AstNode.hpp"
+#include "CachePolicy.hpp"
+#include "Compression.hpp"
 #include "Logger.hpp"
 #include "Method.hpp"
 #include "utils.h"
@@ -21,6 +23,7 @@ class LocationConfig {
     static const std::string ERROR_PAGE_KEY;
     static const std::string AUTOINDEX_KEY;
     static const std::string CGI_PATH_KEY;
+    static const std::string FASTCGI_PASS_KEY;
 
     LocationConfig();
     LocationConfig(const LocationConfig& other);
@@ -34,10 +37,15 @@ class LocationConfig {
     const std::string& getIndex() const;
     const std::string& getRedirect() const;
     const std::map<std::string, std::string>& getCgiPaths() const;
+    const std::string& getFastCgiPass() const;
     size_t getClientBodySize() const;
     const std::vector<Method>& getMethods() const;
     const std::vector<std::pair<size_t, std::string> >& getErrorPages() const;
     bool getAutoindex() const;
+    const Compression& getCompression() const;
+    const CachePolicy& getCachePolicy() const;
+    void inheritCompression(const Compression& serverCompression);
+    void inheritCachePolicy(const CachePolicy& serverCachePolicy);
 
    private:
     Logger logger;
@@ -51,6 +59,9 @@ class LocationConfig {
     std::vector<std::pair<size_t, std::string> > errorPages;
     bool autoindex;
     std::map<std::string, std::string> cgiPaths;
+    std::string fastCgiPass;
+    Compression compression;
+    CachePolicy cachePolicy;
 
     void parseRoot(const AstNode& node);
     void parseIndex(const AstNode& node);
@@ -60,4 +71,7 @@ class LocationConfig {
     void parseErrorPage(const AstNode& node);
     void parseAutoindex(const AstNode& node);
     void parseCgiPath(const AstNode& node);
+    void parseFastCgiPass(const AstNode& node);
+    void parseCompression(const AstNode& node);
+    void parseCachePolicy(const AstNode& node);
 };
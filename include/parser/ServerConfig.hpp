@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "AstNode.hpp"
+#include "CachePolicy.hpp"
 #include "LocationConfig.hpp"
 #include "Logger.hpp"
 
@@ -14,6 +15,12 @@ class ServerConfig {
     static const std::string LISTEN_KEY;
     static const std::string SERVER_NAME_KEY;
     static const std::string LOCATION_KEY;
+    static const std::string KEEPALIVE_TIMEOUT_KEY;
+    static const std::string KEEPALIVE_REQUESTS_KEY;
+    static const std::string FILE_CACHE_SIZE_KEY;
+    static const size_t DEFAULT_KEEPALIVE_TIMEOUT;
+    static const size_t DEFAULT_KEEPALIVE_REQUESTS;
+    static const size_t DEFAULT_FILE_CACHE_SIZE;
 
     ServerConfig();
     ServerConfig(const ServerConfig& other);
@@ -32,6 +39,11 @@ class ServerConfig {
     const std::vector<LocationConfig>& getLocations() const;
     const std::vector<std::pair<size_t, std::string> >& getErrorPages() const;
     bool getAutoindex() const;
+    size_t getKeepaliveTimeout() const;
+    size_t getKeepaliveRequests() const;
+    size_t getFileCacheSize() const;
+    const Compression& getCompression() const;
+    const CachePolicy& getCachePolicy() const;
 
    private:
     Logger logger;
@@ -46,6 +58,11 @@ class ServerConfig {
     std::vector<LocationConfig> locations;
     std::vector<std::pair<size_t, std::string> > errorPages;
     bool autoindex;
+    size_t keepaliveTimeout;
+    size_t keepaliveRequests;
+    size_t fileCacheSize;
+    Compression compression;
+    CachePolicy cachePolicy;
 
     void verifyDuplicatedLocations() const;
     void validMinimumConfig() const;
@@ -58,4 +75,9 @@ class ServerConfig {
     void parseMethod(const AstNode& node);
     void parseErrorPage(const AstNode& node);
     void parseAutoindex(const AstNode& node);
+    void parseKeepaliveTimeout(const AstNode& node);
+    void parseKeepaliveRequests(const AstNode& node);
+    void parseFileCacheSize(const AstNode& node);
+    void parseCompression(const AstNode& node);
+    void parseCachePolicy(const AstNode& node);
 };
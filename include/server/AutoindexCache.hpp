@@ -0,0 +1,70 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Compression.hpp"
+
+struct DirectoryEntry {
+    std::string name;
+    bool isDirectory;
+    time_t mtime;
+    off_t size;
+};
+
+// The entries of a directory sorted by name, with the pages already rendered from them
+struct DirectoryListing {
+    std::vector<DirectoryEntry> entries;
+    time_t mtime;
+    long mtimeNsec;
+    ino_t inode;
+    long long builtAt;
+    long long usedAt;
+    std::map<std::string, GeneratedPage> pages;
+};
+
+// Autoindex pages of a server, rebuilt only when their directory changes
+class AutoindexCache {
+   public:
+    static const size_t MAX_DIRECTORIES;
+    static const size_t MAX_PAGES;
+    static const size_t PAGE_SIZE;
+    static const long long MAX_AGE_IN_MILLIS;
+
+    AutoindexCache();
+    AutoindexCache(const AutoindexCache &other);
+    AutoindexCache &operator=(const AutoindexCache &other);
+    ~AutoindexCache();
+
+    // The page the query asks for, NULL when the directory can't be read or has no such page,
+    // it stays valid until the next call
+    const GeneratedPage *getPage(const std::string &directoryPath, const std::string &uri, const std::string &query, bool &json);
+
+   private:
+    enum SortKey {
+        SORT_NAME,
+        SORT_SIZE,
+        SORT_MTIME,
+    };
+
+    struct Options {
+        bool json;
+        SortKey sort;
+        bool descending;
+        size_t page;
+    };
+
+    std::map<std::string, DirectoryListing> listings;
+
+    DirectoryListing *getListing(const std::string &directoryPath);
+    static bool load(const std::string &directoryPath, DirectoryListing &listing);
+    static Options parseOptions(const std::string &query);
+    static std::string createQuery(const Options &options, size_t page);
+    static void renderHtml(const std::vector<const DirectoryEntry *> &entries, const std::string &uri, const Options &options, size_t pageCount, std::string &page);
+    static void renderJson(const std::vector<const DirectoryEntry *> &entries, std::string &page);
+    void evict();
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "OutputQueue.hpp"
+
+// Destination of a request body, bytes are handed over as they are read from the socket
+class BodySink {
+   public:
+    virtual ~BodySink();
+
+    virtual void write(const char *data, size_t size) = 0;
+    virtual bool failed() const = 0;
+};
+
+// Writes an upload to a temporary file next to the target, which only appears once complete
+class FileBodySink : public BodySink {
+   public:
+    FileBodySink();
+    // An upload in progress is not copied, the copy starts closed
+    FileBodySink(const FileBodySink &other);
+    FileBodySink &operator=(const FileBodySink &other);
+    ~FileBodySink();
+
+    bool open(const std::string &path);
+    void write(const char *data, size_t size);
+    bool failed() const;
+    int commit();
+    void abort();
+    bool isOpen() const;
+
+   private:
+    std::string path;
+    std::string tempPath;
+    int fd;
+    bool error;
+};
+
+// Queues the body for a pipe, the owner watches the queue size to bound buffering
+class QueueBodySink : public BodySink {
+   public:
+    QueueBodySink();
+    QueueBodySink(const QueueBodySink &other);
+    QueueBodySink &operator=(const QueueBodySink &other);
+    ~QueueBodySink();
+
+    void attach(OutputQueue *queue);
+    void detach();
+    void write(const char *data, size_t size);
+    bool failed() const;
+
+   private:
+    OutputQueue *queue;
+};
@@ -2,19 +2,43 @@
 
 #include <poll.h>
 
+#include <map>
 #include <string>
 
+#include "BodySink.hpp"
 #include "Configurations.hpp"
+#include "EventLoop.hpp"
+#include "FastCgi.hpp"
+#include "FdRegistry.hpp"
 #include "HttpRequest.hpp"
 #include "HttpResponse.hpp"
 #include "Logger.hpp"
+#include "OutputQueue.hpp"
+#include "ProcessReaper.hpp"
 #include "Server.hpp"
+#include "TimerWheel.hpp"
+
+// Where the script's output stands: its headers are buffered until complete, then the body is relayed as it comes
+enum CgiState {
+    CGI_HEADERS,
+    CGI_BODY,
+    CGI_DISCARD,
+};
 
 class Client {
    public:
     static const size_t READ_BUFFER_SIZE;
-    static const size_t WRITE_BUFFER_SIZE;
     static const long long CGI_TIMEOUT_IN_MILLIS;
+    static const long long HEADER_TIMEOUT_IN_MILLIS;
+    static const long long BODY_TIMEOUT_IN_MILLIS;
+    static const long long SEND_TIMEOUT_IN_MILLIS;
+    static const size_t MAX_PIPELINE_DEPTH;
+    static const size_t MAX_BODY_BACKLOG;
+    static const size_t MAX_CGI_BACKLOG;
+    static const size_t MAX_CGI_HEADER_SIZE;
+
+    // Reads the server's environment, which every script inherits, once before serving
+    static void loadInheritedEnvironment();
 
     Client();
     ~Client();
@@ -22,34 +46,97 @@ class Client {
     Client(const Client& other);
     Client& operator=(const Client& other);
 
+    void reset(int fd);
     int getFd() const;
     int getPipeOut() const;
-    bool isFdValid(int fd) const;
-    int processSendedData(int fdAffected, const std::vector<Server>& servers, std::vector<pollfd>& fdsToAdd);
+    void setKeepaliveTimeout(size_t seconds);
+    void setFastCgiPool(FastCgiPool* pool);
+    void setProcessReaper(ProcessReaper* reaper);
+    int processSendedData(int fdAffected, const std::vector<Server>& servers, EventLoop& eventLoop, FdRegistry& registry);
     int sendResponse(int clientSocket);
-    void closeAll() const;
+    int resumeRequests(const std::vector<Server>& servers, EventLoop& eventLoop, FdRegistry& registry);
+    bool hasPendingOutput() const;
+    bool isFinished() const;
+    void updateEvents(EventLoop& eventLoop) const;
+    void updateTimers(TimerWheel& timers);
+    void closeAll(EventLoop& eventLoop, FdRegistry& registry);
+    void processHandUp(int fdAffected);
     void readCgiResponse();
-    void verifyCgiTimeout(std::vector<int>& fdsToRemove);
+    void processCgiExit(int status);
+    void processCgiTimeout(std::vector<int>& fdsToRemove);
 
    private:
+    // Name to "NAME=value" entry
+    static std::map<std::string, std::string> inheritedEnvironment;
+
     int fd;
     int pipeIn;
     int pipeOut;
     HttpRequest request;
     HttpResponse response;
-    std::string responseStr;
+    OutputQueue output;
     std::string cgiOutputStr;
-    std::string cgiInputStr;
+    CgiState cgiState;
+    bool cgiChunked;
+    bool cgiOutputRead;
+    OutputQueue cgiInput;
     int cgiPid;
-    long long cgiStarProcessTimestamp;
-    Configurations cgiConfig;
+    int cgiStatus;
+    ProcessReaper* processReaper;
+    int upstreamFd;
+    std::string upstreamAddress;
+    FastCgiReader upstreamReader;
+    FastCgiPool* fastCgiPool;
+    // Owned by the server, which outlives every request
+    const Configurations* cgiConfig;
+    size_t requestCount;
+    bool keepAlive;
+    size_t pipelinedRequests;
+    bool readPaused;
+    long long keepaliveTimeout;
+    Timer idleTimer;
+    Timer cgiTimer;
+    const Server* requestServer;
+    const Configurations* requestConfig;
+    FileBodySink uploadSink;
+    QueueBodySink cgiSink;
+    FastCgiBodySink fastCgiSink;
+    BodySink* bodySink;
     Logger logger;
 
-    std::string createCgiProcess(const Configurations& config, std::string& execPath, std::string& scriptPath, std::vector<pollfd>& fdsToAdd);
-    void matchUriAndResponseClient(const std::vector<Server>& servers, std::vector<pollfd>& fdsToAdd);
-    std::string processRequest(const Configurations& config, std::vector<pollfd>& fdsToAdd);
-    std::string processGetRequest(const Configurations& config, const std::string& path, const std::string& uri);
-    std::string processPostRequest(const Configurations& config, const std::string& path, const std::string& uri, const std::map<std::string, std::string>& headers);
-    std::string processDeleteRequest(const Configurations& config, const std::string& path);
+    void createCgiEnvironment(const std::string& scriptPath, std::map<std::string, std::string>& environment) const;
+    void createCgiProcess(const Configurations& config, std::string& execPath, std::string& scriptPath, EventLoop& eventLoop, FdRegistry& registry);
+    pid_t spawnCgiProcess(const std::string& execPath, const std::string& scriptPath, int pipeInput[2], int pipeOutput[2]);
+    void startFastCgi(const Configurations& config, const std::string& scriptPath, EventLoop& eventLoop, FdRegistry& registry);
+    int processUpstream(EventLoop& eventLoop, FdRegistry& registry);
+    int failUpstream();
+    void releaseUpstream(EventLoop& eventLoop, FdRegistry& registry);
+    void closeUpstream(EventLoop& eventLoop, FdRegistry& registry);
+    bool isCgiRunning() const;
+    void terminateCgiProcess();
+    void finishCgiProcess();
+    void finishCgiResponse(bool failed, size_t errorStatus);
+    bool isPipelineBlocked() const;
+    bool isCgiOutputPaused() const;
+    int readCgiOutput(int pipeFd);
+    void relayCgiOutput(const char* data, size_t size);
+    bool sendCgiHeaders(const std::string& headerBlock);
+    void pushCgiBody(const char* data, size_t size);
+    void dispatchRequests(const std::vector<Server>& servers, EventLoop& eventLoop, FdRegistry& registry);
+    void matchUri(const std::vector<Server>& servers);
+    void updateConnection();
+    void routeBody(EventLoop& eventLoop, FdRegistry& registry);
+    void responseClient(EventLoop& eventLoop, FdRegistry& registry);
+    void closeCgiInput(EventLoop& eventLoop, FdRegistry& registry);
+    bool isBodyTooLarge() const;
+    void rejectBody(EventLoop& eventLoop, FdRegistry& registry);
+    bool rejectRequest(const Configurations& config);
+    bool rejectPrecondition(const Configurations& config, const std::string& path);
+    bool openUpload(const Configurations& config, const std::string& path);
+    void processRequest(const Configurations& config, EventLoop& eventLoop, FdRegistry& registry);
+    std::string findPrecompressed(const std::string& path, bool useStatic);
+    void processGetRequest(const Configurations& config, const std::string& path, const std::string& uri);
+    void processPostRequest(const Configurations& config, const std::string& uri);
+    void processDeleteRequest(const Configurations& config, const std::string& path);
     std::vector<Server>::const_iterator findServer(const std::vector<Server>& servers, const std::string& host) const;
 };
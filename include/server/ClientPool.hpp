@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include "Client.hpp"
+
+class ClientPool {
+   public:
+    static const size_t CHUNK_SIZE;
+
+    ClientPool();
+    ClientPool(const ClientPool &other);
+    ClientPool &operator=(const ClientPool &other);
+    ~ClientPool();
+
+    Client *acquire(int fd);
+    void release(Client *client);
+    size_t size() const;
+
+   private:
+    std::vector<Client *> chunks;
+    std::vector<Client *> freeList;
+    size_t activeCount;
+
+    void grow();
+    void destroy();
+};
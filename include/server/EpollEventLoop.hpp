@@ -0,0 +1,36 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+
+#include <vector>
+
+#include "EventLoop.hpp"
+
+class EpollEventLoop : public EventLoop {
+   public:
+    static const size_t MAX_EVENTS;
+
+    EpollEventLoop(bool edgeTriggered);
+    ~EpollEventLoop();
+
+    void watch(int fd, short events);
+    void unwatch(int fd);
+    int wait(std::vector<struct pollfd> &ready, int timeout);
+    const std::string &getName() const;
+
+   private:
+    int epollFd;
+    bool edgeTriggered;
+    std::vector<int> interests;
+    std::vector<struct epoll_event> events;
+
+    uint32_t toEpollEvents(short events) const;
+    static short fromEpollEvents(uint32_t events);
+
+    EpollEventLoop(const EpollEventLoop &other);
+    EpollEventLoop &operator=(const EpollEventLoop &other);
+};
+
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <poll.h>
+
+#include <string>
+#include <vector>
+
+class EventLoop {
+   public:
+    static const std::string POLL_BACKEND;
+    static const std::string EPOLL_BACKEND;
+    static const std::string EPOLL_EDGE_BACKEND;
+    static const std::string DEFAULT_BACKEND;
+
+    virtual ~EventLoop();
+
+    static EventLoop *create(const std::string &backend);
+    static bool isValidBackend(const std::string &backend);
+
+    // Adds the fd if it is not watched yet, otherwise changes its events
+    virtual void watch(int fd, short events) = 0;
+    virtual void unwatch(int fd) = 0;
+    // Fills ready only with the fds that have revents set
+    virtual int wait(std::vector<struct pollfd> &ready, int timeout) = 0;
+    virtual const std::string &getName() const = 0;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "BodySink.hpp"
+#include "Logger.hpp"
+#include "OutputQueue.hpp"
+
+enum FastCgiRecordType {
+    FCGI_BEGIN_REQUEST = 1,
+    FCGI_END_REQUEST = 3,
+    FCGI_PARAMS = 4,
+    FCGI_STDIN = 5,
+    FCGI_STDOUT = 6,
+    FCGI_STDERR = 7,
+};
+
+// Encodes the records of a single responder request, every connection carries one request at a time
+class FastCgiRecord {
+   public:
+    static const size_t HEADER_SIZE;
+    static const size_t MAX_CONTENT_SIZE;
+    static const int REQUEST_ID;
+
+    static void pushBeginRequest(OutputQueue &output);
+    static void pushParams(OutputQueue &output, const std::map<std::string, std::string> &params);
+    // An empty stream record marks the end of the stream
+    static void pushStream(OutputQueue &output, FastCgiRecordType type, const char *data, size_t size);
+
+   private:
+    FastCgiRecord();
+};
+
+// Decodes the records sent back by the application, keeping partial records between reads
+class FastCgiReader {
+   public:
+    FastCgiReader();
+    FastCgiReader(const FastCgiReader &other);
+    FastCgiReader &operator=(const FastCgiReader &other);
+    ~FastCgiReader();
+
+    // Appends the content of stdout records to output, false on a malformed record
+    bool read(const char *data, size_t size, std::string &output);
+    bool isEnded() const;
+    bool isReusable() const;
+    bool hasFailed() const;
+    void reset();
+
+   private:
+    Logger logger;
+    std::string pending;
+    bool ended;
+    long appStatus;
+    int protocolStatus;
+};
+
+// Frames the request body as stdin records on the upstream connection's queue
+class FastCgiBodySink : public BodySink {
+   public:
+    FastCgiBodySink();
+    FastCgiBodySink(const FastCgiBodySink &other);
+    FastCgiBodySink &operator=(const FastCgiBodySink &other);
+    ~FastCgiBodySink();
+
+    void attach(OutputQueue *queue);
+    void detach();
+    void finish();
+    void write(const char *data, size_t size);
+    bool failed() const;
+
+   private:
+    OutputQueue *queue;
+};
+
+// Connections to the applications kept open between requests, keyed by the fastcgi_pass address
+class FastCgiPool {
+   public:
+    static const size_t MAX_IDLE_CONNECTIONS;
+
+    FastCgiPool();
+    FastCgiPool(const FastCgiPool &other);
+    FastCgiPool &operator=(const FastCgiPool &other);
+    ~FastCgiPool();
+
+    // Accepts unix:/path/to/socket or ipv4:port
+    static bool isValidAddress(const std::string &address);
+
+    int acquire(const std::string &address);
+    void release(const std::string &address, int fd);
+    void clear();
+
+   private:
+    Logger logger;
+    std::map<std::string, std::vector<int> > idle;
+
+    int connectTo(const std::string &address);
+    static bool parseAddress(const std::string &address, struct sockaddr_storage &storage, socklen_t &length);
+    static bool isAlive(int fd);
+};
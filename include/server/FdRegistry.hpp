@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+class Client;
+class ServerManager;
+
+enum FdRole {
+    FD_NONE,
+    FD_LISTENER,
+    FD_CLIENT,
+    FD_CGI_INPUT,
+    FD_CGI_OUTPUT,
+    FD_FASTCGI,
+    FD_SIGNAL,
+};
+
+struct FdEntry {
+    FdRole role;
+    ServerManager *server;
+    Client *client;
+};
+
+class FdRegistry {
+   public:
+    FdRegistry();
+    FdRegistry(const FdRegistry &other);
+    FdRegistry &operator=(const FdRegistry &other);
+    ~FdRegistry();
+
+    void add(int fd, FdRole role, ServerManager *server, Client *client);
+    void remove(int fd);
+    const FdEntry &get(int fd) const;
+
+   private:
+    static const FdEntry EMPTY_ENTRY;
+
+    std::vector<FdEntry> entries;
+};
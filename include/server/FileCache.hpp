@@ -0,0 +1,76 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+
+#include "Compression.hpp"
+#include "SharedBuffer.hpp"
+
+// A gzip encoding of a cached file, empty when it wouldn't be smaller. It is never changed once made
+struct GzipVariant {
+    SharedBuffer content;
+    std::string etag;
+    // The .gz sibling it was read from, empty when it was compressed from the file
+    std::string path;
+    time_t mtime;
+    long mtimeNsec;
+    off_t size;
+};
+
+// A file's content with the headers that describe it, computed once when it is loaded. The content is
+// shared with the responses sending it, so an entry can be evicted or reloaded while they are in flight
+struct CachedFile {
+    SharedBuffer content;
+    std::string contentType;
+    std::string lastModified;
+    std::string etag;
+    time_t mtime;
+    long mtimeNsec;
+    off_t size;
+    ino_t inode;
+    long long validatedAt;
+    // One per compression level asked for, and the .gz sibling under STATIC_GZIP_VARIANT, so
+    // locations compressing the same file differently each keep theirs
+    std::map<int, GzipVariant> gzipVariants;
+};
+
+// Least recently used small files of a server, bounded by the total size of their content
+class FileCache {
+   public:
+    static const off_t MAX_FILE_SIZE;
+    static const long long REVALIDATE_INTERVAL_IN_MILLIS;
+    // Below every compression level
+    static const int STATIC_GZIP_VARIANT;
+
+    FileCache();
+    FileCache(size_t maxSize);
+    FileCache(const FileCache &other);
+    FileCache &operator=(const FileCache &other);
+    ~FileCache();
+
+    // NULL when the path is not a regular file that fits in the cache, the entry stays valid until the next call
+    const CachedFile *get(const std::string &path);
+    // Same as get, with the gzip variant the compression settings call for in gzip, NULL when none is smaller
+    const CachedFile *getGzip(const std::string &path, const Compression &compression, const GzipVariant *&gzip);
+    size_t size() const;
+
+   private:
+    typedef std::list<std::pair<std::string, CachedFile> > EntryList;
+
+    size_t maxSize;
+    size_t usedSize;
+    EntryList entries;
+    std::map<std::string, EntryList::iterator> index;
+
+    bool load(const std::string &path, CachedFile &file) const;
+    bool isFresh(const std::string &path, CachedFile &file, long long now) const;
+    const GzipVariant *findGzip(const std::string &path, CachedFile &file, int key);
+    bool loadGzip(const std::string &path, const CachedFile &file, int key, GzipVariant &variant) const;
+    static size_t getEntrySize(const CachedFile &file);
+    void trim();
+    void erase(EntryList::iterator entry);
+};
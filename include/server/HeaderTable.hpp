@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Well-known headers are interned when parsed so lookups skip string compares
+enum HeaderId {
+    HEADER_HOST,
+    HEADER_CONTENT_LENGTH,
+    HEADER_CONTENT_TYPE,
+    HEADER_COOKIE,
+    HEADER_IF_NONE_MATCH,
+    HEADER_CONNECTION,
+    HEADER_TRANSFER_ENCODING,
+    HEADER_ACCEPT_ENCODING,
+    HEADER_RANGE,
+    HEADER_IF_RANGE,
+    HEADER_IF_MATCH,
+    HEADER_IF_MODIFIED_SINCE,
+    HEADER_IF_UNMODIFIED_SINCE,
+    HEADER_UNKNOWN,
+};
+
+struct HeaderField {
+    HeaderId id;
+    size_t keyStart;
+    size_t keyLength;
+    size_t valueStart;
+    size_t valueLength;
+};
+
+// Header fields as offsets into the request buffer, nothing is copied until a value is read
+class HeaderTable {
+   public:
+    static const size_t RESERVED_FIELDS;
+
+    HeaderTable();
+    HeaderTable(const HeaderTable &other);
+    HeaderTable &operator=(const HeaderTable &other);
+    ~HeaderTable();
+
+    void add(const HeaderField &field);
+    void clear();
+    size_t size() const;
+    const HeaderField &at(size_t index) const;
+    const HeaderField *find(HeaderId id) const;
+    const HeaderField *find(const std::string &buffer, const std::string &name) const;
+
+    static HeaderId intern(const char *key, size_t length);
+
+   private:
+    std::vector<HeaderField> fields;
+    int known[HEADER_UNKNOWN];
+};
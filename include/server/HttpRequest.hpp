@@ -3,15 +3,42 @@
 #include <map>
 #include <string>
 
+#include "BodySink.hpp"
+#include "CharTable.hpp"
+#include "HeaderTable.hpp"
 #include "Logger.hpp"
 #include "Method.hpp"
+#include "Preconditions.hpp"
+
+enum ParseState {
+    PARSE_METHOD,
+    PARSE_URI,
+    PARSE_VERSION,
+    PARSE_REQUEST_LINE_END,
+    PARSE_HEADER_START,
+    PARSE_HEADER_KEY,
+    PARSE_HEADER_VALUE,
+    PARSE_HEADER_LINE_END,
+    PARSE_HEADERS_END,
+    PARSE_BODY,
+    PARSE_DONE,
+};
+
+enum ChunkState {
+    CHUNK_SIZE,
+    CHUNK_EXTENSION,
+    CHUNK_SIZE_END,
+    CHUNK_DATA,
+    CHUNK_DATA_END,
+    CHUNK_DATA_LF,
+    CHUNK_TRAILER_START,
+    CHUNK_TRAILER,
+    CHUNK_TRAILER_END,
+};
 
 class HttpRequest {
    public:
-    static const std::string HEADER_HOST_KEY;
-    static const std::string HEADER_COOKIES_KEY;
     static const std::string URI_CHARACTERS;
-    static const std::string HEADER_CONTENT_TYPE_KEY;
 
     HttpRequest();
     HttpRequest(const HttpRequest &copy);
@@ -20,16 +47,33 @@ class HttpRequest {
 
     bool digestRequest(const std::string &data);
     void clear();
+    void discard();
 
     Method getMethod() const;
     const std::string &getUri() const;
     const std::string &getQueryParameters() const;
     const std::string &getVersion() const;
-    const std::map<std::string, std::string> &getHeaders() const;
+    bool hasHeader(HeaderId id) const;
+    std::string getHeader(HeaderId id) const;
+    std::string getHeader(const std::string &name) const;
+    size_t getHeaderCount() const;
+    std::string getHeaderName(size_t index) const;
+    std::string getHeaderValue(size_t index) const;
     const std::map<std::string, std::string> &getCookies() const;
     const std::string &getBody() const;
+    size_t getContentLength() const;
+    size_t getBodySize() const;
+    bool isChunked() const;
     bool isComplete() const;
-    std::string getEtag() const;
+    bool isEmpty() const;
+    bool hasHeaders() const;
+    bool isAwaitingBody() const;
+    bool isReadingBody() const;
+    void acceptBody(BodySink *sink);
+    Preconditions getPreconditions() const;
+    bool isKeepAlive() const;
+    bool acceptsEncoding(const std::string &coding) const;
+    static bool verifyUri(const std::string &uri);
     static bool verifyHeaderKey(const std::string &key);
     static bool verifyHeaderValue(const std::string &value);
 
@@ -37,24 +81,48 @@ class HttpRequest {
     Logger logger;
 
     std::string rawData;
+    ParseState parseState;
+    size_t parsePos;
+    size_t tokenStart;
+    size_t keyEnd;
     Method method;
     std::string uri;
     std::string queryParameters;
     std::string version;
-    std::map<std::string, std::string> headers;
+    HeaderTable headers;
     std::map<std::string, std::string> cookies;
     std::string body;
     size_t contentLength;
+    size_t bodyReceived;
+    bool chunked;
+    ChunkState chunkState;
+    size_t chunkRemaining;
+    bool chunkHasDigits;
+    bool bodyAccepted;
+    BodySink *bodySink;
     bool complete;
 
     static const std::string HEADER_VALUE_CHARACTERS;
     static const std::string HEADER_KEY_CHARACTERS;
     static const std::string CONTENT_LENTH;
     static const std::string HTTP_VERSION;
-    static const std::string CONTENT_LENTH_HEADER_KEY;
-    static const std::string HEADER_ETAG_KEY;
+    static const std::string CHUNKED_ENCODING;
+    static const size_t MAX_CHUNK_SIZE;
+    static const CharTable URI_TABLE;
+    static const CharTable HEADER_VALUE_TABLE;
+    static const CharTable HEADER_KEY_TABLE;
+    static const CharTable URI_DELIMITERS;
+    static const CharTable HEADER_KEY_DELIMITERS;
+    static const CharTable LINE_DELIMITERS;
 
-    void parseFristLine();
-    void parseHeaders(size_t endPos);
+    void parse();
+    void parseMethod(size_t start, size_t end);
+    void parseUri(size_t start, size_t end);
+    void parseVersion(size_t start, size_t end);
+    void parseHeader(size_t start, size_t keyEnd, size_t end);
+    void finishHeaders();
+    void consumeBody();
+    bool consumeChunks();
+    void deliverBody(size_t start, size_t size);
     void parseCookies(const std::string &cookieHeader);
 };
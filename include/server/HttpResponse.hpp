@@ -1,34 +1,72 @@
 #pragma once
 
+#include <sys/types.h>
+
 #include <map>
 #include <string>
 #include <vector>
 
+#include "CachePolicy.hpp"
+#include "Compression.hpp"
+#include "Preconditions.hpp"
+#include "SharedBuffer.hpp"
+
+class AutoindexCache;
+class OutputQueue;
+struct CachedFile;
+struct GzipVariant;
+
 class HttpResponse {
    private:
     static const std::string SERVER_NAME;
     static const std::string HTTP_VERSION;
     static const std::string DEFAULT_MIME_TYPE;
+    static const size_t MAX_RANGES;
 
     size_t httpStatus;
     std::string contentType;
     std::string body;
+    // The generated page of the response, its gzip form is reused instead of compressing again. While
+    // body is empty the page is sent from where it is kept
+    const GeneratedPage *page;
     std::string lastModified;
     std::string fileName;
     std::string etag;
     std::string location;
+    std::string connection;
+    std::string keepAlive;
+    std::string contentEncoding;
+    bool vary;
+    Compression compression;
+    bool acceptsGzip;
+    CachePolicy cachePolicy;
     bool hasZeroContentLength;
+    bool hasFileBody;
+    bool chunked;
+    int fileFd;
+    // A cached file's content, sent from the cache the way fileFd is sent from the disk
+    SharedBuffer cachedBody;
+    off_t fileOffset;
+    off_t fileSize;
+    std::string range;
+    std::string ifRange;
+    // Inclusive byte offsets, with the header of each part and the closing boundary when there are several
+    std::vector<std::pair<off_t, off_t> > ranges;
+    std::vector<std::string> partHeaders;
     std::map<std::string, std::string> extraHeaders;
     std::vector<std::string> cookies;
 
     std::string createDate();
-    std::string getStatusMessage();
-    std::string setContentTypeFromFilename();
-    void createAutoindex(const std::string &directoryPath, const std::string &uri);
+    static std::string getStatusMessage(size_t status);
+    static const GeneratedPage &getDefaultErrorPage(size_t status);
+    std::string getFileMimeType() const;
+    const std::string &compressBody();
+    bool matchesIfRange() const;
+    bool parseRanges(off_t size);
+    void selectRanges();
+    void pushRanges(OutputQueue &output);
     void clear();
-    void generateDefaultErrorPage();
-    std::string createResponse();
-    void generateEtag(const struct stat &fileInfo);
+    void createResponse(OutputQueue &output);
 
    public:
     HttpResponse();
@@ -36,11 +74,26 @@ class HttpResponse {
     ~HttpResponse();
     HttpResponse &operator=(const HttpResponse &assign);
 
-    std::string createResponseFromStatus(size_t status);
-    std::string createResponseFromLocation(size_t status, const std::string &location);
-    std::string createCgiResponse(size_t status, const std::string &body, const std::map<std::string, std::string> &headers, const std::vector<std::string> &cookies);
-    std::string createErrorResponse(size_t status, const std::string &root, const std::vector<std::pair<size_t, std::string> > &errorPages);
-    std::string createFileResponse(const std::string &filePath, const std::string &etag, const std::string &root, const std::vector<std::pair<size_t, std::string> > &errorPages);
-    std::string createIndexResponse(const std::string &directoryPath, const std::string &uri, const std::string &root, const std::vector<std::pair<size_t, std::string> > &errorPages);
+    static std::string getMimeType(const std::string &fileName);
+    static std::string getLastModified(const struct stat &fileInfo);
+    static std::string generateEtag(const struct stat &fileInfo);
+
+    void createResponseFromStatus(OutputQueue &output, size_t status);
+    void createResponseFromLocation(OutputQueue &output, size_t status, const std::string &location);
+    void createStreamResponse(OutputQueue &output, size_t status, const std::map<std::string, std::string> &headers, const std::vector<std::string> &cookies, bool chunked);
+    static void pushChunk(OutputQueue &output, std::string &data);
+    static void pushLastChunk(OutputQueue &output);
+    void createErrorResponse(OutputQueue &output, size_t status, const std::map<size_t, GeneratedPage> &errorPages);
+    void createFileResponse(OutputQueue &output, const std::string &filePath, const Preconditions &preconditions, const std::map<size_t, GeneratedPage> &errorPages);
+    void createCachedFileResponse(OutputQueue &output, const CachedFile &file, const GzipVariant *gzip, const Preconditions &preconditions, const std::map<size_t, GeneratedPage> &errorPages);
+    void createIndexResponse(OutputQueue &output, const std::string &directoryPath, const std::string &uri, const std::string &query, AutoindexCache &cache, const std::map<size_t, GeneratedPage> &errorPages);
+    void setConnection(bool keepAlive, size_t timeout, size_t maxRequests);
+    // Applies to the next response only
+    void setCompression(const Compression &compression, bool acceptsGzip);
+    void setEncoding(const std::string &encoding);
+    // Applies to the next response only
+    void setCachePolicy(const CachePolicy &cachePolicy);
+    // Applies to the next response only
+    void setRange(const std::string &range, const std::string &ifRange);
     void setCookie(const std::string &key, const std::string &value, const std::string &expires, const std::string &path, bool httpOnly);
 };
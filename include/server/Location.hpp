@@ -35,5 +35,8 @@ class Location {
     std::vector<std::pair<size_t, std::string> > errorPages;
     bool autoindex;
     std::map<std::string, std::string> cgiPaths;
+    std::string fastCgiPass;
+    Compression compression;
+    CachePolicy cachePolicy;
     Configurations config;
 };
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <signal.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include "Config.hpp"
+#include "Logger.hpp"
+
+class MasterProcess {
+   public:
+    static const long long RESPAWN_THROTTLE_IN_MILLIS;
+
+    MasterProcess();
+    MasterProcess(const Config &config);
+    MasterProcess(const MasterProcess &other);
+    MasterProcess &operator=(const MasterProcess &other);
+    ~MasterProcess();
+
+    int run();
+
+   private:
+    Logger logger;
+
+    Config config;
+    std::vector<pid_t> workers;
+    std::vector<long long> workersStartTimestamp;
+    sigset_t signals;
+
+    void runServers();
+    void spawnWorker(size_t index);
+    void runWorker(size_t index);
+    void pinToCpu(size_t index);
+    bool reapWorkers(bool stopping);
+    void forwardSignal(int signal);
+    size_t countWorkers() const;
+};
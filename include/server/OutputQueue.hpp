@@ -0,0 +1,60 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <deque>
+#include <string>
+
+#include "SharedBuffer.hpp"
+
+class OutputQueue {
+   public:
+    static const size_t WRITE_CHUNK_SIZE;
+    static const int MAX_IOVECS;
+
+    enum Status {
+        OUTPUT_DONE,
+        OUTPUT_PENDING,
+        OUTPUT_ERROR,
+    };
+
+    OutputQueue();
+    OutputQueue(const OutputQueue &other);
+    OutputQueue &operator=(const OutputQueue &other);
+    ~OutputQueue();
+
+    // Takes the content of data without copying it, data is left empty
+    void push(std::string &data);
+    // Sends data from where it is, it must stay unchanged until it is written or the queue is cleared
+    void pushShared(const std::string &data);
+    // Sends a region of the buffer, which is held until the region is written or the queue is cleared
+    void pushShared(const SharedBuffer &buffer, size_t offset, size_t length);
+    // Takes ownership of fileFd, which is closed once sent or cleared, unless it is shared with a later segment
+    void pushFile(int fileFd, off_t offset, off_t size, bool ownsFile = true);
+    Status flush(int fd);
+    bool empty() const;
+    size_t size() const;
+    void clear();
+
+   private:
+    struct Segment {
+        std::string data;
+        // Borrowed content sent instead of data, NULL when the segment owns its content
+        const std::string *shared;
+        // Keeps shared alive when it belongs to a buffer
+        SharedBuffer buffer;
+        size_t offset;
+        size_t end;
+        int fileFd;
+        bool ownsFile;
+        off_t fileOffset;
+        off_t fileRemaining;
+    };
+
+    std::deque<Segment> segments;
+    size_t pendingBytes;
+
+    ssize_t writeFile(int fd, size_t &bytesToSend);
+    ssize_t writeBuffers(int fd, size_t &bytesToSend);
+    void popFront();
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include "EventLoop.hpp"
+
+class PollEventLoop : public EventLoop {
+   public:
+    PollEventLoop();
+    ~PollEventLoop();
+
+    void watch(int fd, short events);
+    void unwatch(int fd);
+    int wait(std::vector<struct pollfd> &ready, int timeout);
+    const std::string &getName() const;
+
+   private:
+    std::vector<struct pollfd> fds;
+    std::vector<int> positions;
+
+    PollEventLoop(const PollEventLoop &other);
+    PollEventLoop &operator=(const PollEventLoop &other);
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+
+// The conditional headers of a request, evaluated against the current state of its target
+class Preconditions {
+   public:
+    enum Result {
+        PRECONDITION_PASSED,
+        PRECONDITION_NOT_MODIFIED,
+        PRECONDITION_FAILED,
+    };
+
+    Preconditions();
+    Preconditions(const std::string &ifMatch, const std::string &ifNoneMatch, const std::string &ifModifiedSince, const std::string &ifUnmodifiedSince);
+    Preconditions(const Preconditions &other);
+    Preconditions &operator=(const Preconditions &other);
+    ~Preconditions();
+
+    // A target that doesn't exist has no validators, only "*" can be compared with it
+    Result evaluate(const std::string &etag, time_t lastModified, bool exists, bool safeMethod) const;
+
+   private:
+    std::string ifMatch;
+    std::string ifNoneMatch;
+    // -1 when the header is absent or not a valid date, which makes it ignored
+    time_t ifModifiedSince;
+    time_t ifUnmodifiedSince;
+
+    static time_t parseDate(const std::string &date);
+    static bool matches(const std::string &list, const std::string &etag, bool exists, bool weak);
+};
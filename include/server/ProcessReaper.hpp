@@ -0,0 +1,47 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Logger.hpp"
+#include "TimerWheel.hpp"
+
+class Client;
+
+// Collects the scripts' exit statuses from the event loop, SIGCHLD only wakes it through a self-pipe
+class ProcessReaper {
+   public:
+    static const long long KILL_DELAY_IN_MILLIS;
+
+    ProcessReaper();
+    ProcessReaper(const ProcessReaper &other);
+    ProcessReaper &operator=(const ProcessReaper &other);
+    ~ProcessReaper();
+
+    // Installs the SIGCHLD handler and returns the fd to watch for reading
+    int init(TimerWheel &timers);
+    void watch(pid_t pid, Client *client);
+    // Asks the process to stop and kills it if it is still running after the delay, its exit goes unreported
+    void terminate(pid_t pid);
+    // Reaps every exited process, the clients that were told about an exit are added to notified
+    void reap(std::vector<Client *> &notified);
+    void processTimeout();
+
+   private:
+    Logger logger;
+    int pipeFds[2];
+    TimerWheel *timers;
+    Timer killTimer;
+    std::map<pid_t, Client *> children;
+    std::deque<std::pair<pid_t, long long> > terminating;
+
+    static int signalFd;
+
+    static void handleSignal(int signal);
+    void forget(pid_t pid);
+    void close();
+};
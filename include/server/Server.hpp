@@ -3,7 +3,9 @@
 #include <string>
 #include <vector>
 
+#include "AutoindexCache.hpp"
 #include "Configurations.hpp"
+#include "FileCache.hpp"
 #include "HttpRequest.hpp"
 #include "Location.hpp"
 #include "Logger.hpp"
@@ -26,8 +28,12 @@ class Server {
     const std::vector<Location> &getLocations() const;
     const std::vector<Method> &getMethods() const;
     size_t getClientBodySize() const;
+    size_t getKeepaliveTimeout() const;
+    size_t getKeepaliveRequests() const;
     std::vector<Location>::const_iterator matchUri(std::string uri) const;
     const Configurations &getConfig() const;
+    FileCache &getFileCache() const;
+    AutoindexCache &getAutoindexCache() const;
 
    private:
     Logger logger;
@@ -42,5 +48,10 @@ class Server {
     std::vector<Location> locations;
     std::vector<std::pair<size_t, std::string> > errorPages;
     bool autoindex;
+    size_t keepaliveTimeout;
+    size_t keepaliveRequests;
     Configurations config;
+    // Filled while serving, which doesn't change the server itself
+    mutable FileCache fileCache;
+    mutable AutoindexCache autoindexCache;
 };
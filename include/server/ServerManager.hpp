@@ -4,12 +4,18 @@
 #include <vector>
 
 #include "Client.hpp"
+#include "ClientPool.hpp"
+#include "EventLoop.hpp"
+#include "FastCgi.hpp"
+#include "FdRegistry.hpp"
 #include "HttpRequest.hpp"
 #include "HttpResponse.hpp"
 #include "Location.hpp"
 #include "Logger.hpp"
+#include "ProcessReaper.hpp"
 #include "Server.hpp"
 #include "ServerConfig.hpp"
+#include "TimerWheel.hpp"
 
 class ServerManager {
    public:
@@ -23,17 +29,16 @@ class ServerManager {
 
     int initServer();
     std::vector<int> finishServer() const;
-    int acceptConnection();
+    Client *acceptConnection();
 
     int getPort() const;
     in_addr_t getHost() const;
     int getFd() const;
-    int processClientRequest(int clientSocket, std::vector<pollfd> &fdsToAdd);
-    int sendClientResponse(int clientSocket);
-    int processHandUp(int clientSocket);
-    bool isClient(int clientSocket) const;
-    bool isPipeOutClient(int clientSocket);
-    void verifyClientsCgiTimeout(std::vector<int> &fdsToRemove);
+    void setProcessReaper(ProcessReaper *reaper);
+    int processClientRequest(int fd, EventLoop &eventLoop, FdRegistry &registry, TimerWheel &timers);
+    int sendClientResponse(int fd, EventLoop &eventLoop, FdRegistry &registry, TimerWheel &timers);
+    int processHandUp(int fd, EventLoop &eventLoop, FdRegistry &registry, TimerWheel &timers);
+    void processTimeout(const Timer &timer, std::vector<int> &fdsToRemove, EventLoop &eventLoop, FdRegistry &registry, TimerWheel &timers);
 
    private:
     Logger logger;
@@ -43,10 +48,13 @@ class ServerManager {
     int port;
     in_addr_t host;
     std::vector<Server> servers;
-    std::vector<Client> clients;
+    ClientPool clientPool;
+    FastCgiPool fastCgiPool;
+    ProcessReaper *processReaper;
+    std::vector<Client *> clients;
+    std::vector<int> clientPositions;
     HttpRequest request;
     HttpResponse response;
 
-    int removeClient(int clientSocket);
-    Client &getClient(int clientSocket);
+    int removeClient(int clientSocket, EventLoop &eventLoop, FdRegistry &registry);
 };
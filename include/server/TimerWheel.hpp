@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+enum TimerType {
+    TIMER_IDLE,
+    TIMER_CGI,
+    TIMER_KILL,
+};
+
+class Timer {
+   public:
+    Timer();
+    Timer(int fd, TimerType type);
+    // Copies only the owner, a copy is never scheduled
+    Timer(const Timer &other);
+    Timer &operator=(const Timer &other);
+    ~Timer();
+
+    int getFd() const;
+    TimerType getType() const;
+    bool isScheduled() const;
+    void cancel();
+
+   private:
+    friend class TimerWheel;
+
+    int fd;
+    TimerType type;
+    long long expires;
+    Timer *prev;
+    Timer *next;
+};
+
+// Hierarchical timing wheel, timers are intrusive so arming and cancelling are O(1)
+class TimerWheel {
+   public:
+    static const long long TICK_IN_MILLIS;
+    static const int LEVEL_BITS;
+    static const int LEVELS;
+
+    TimerWheel();
+    TimerWheel(const TimerWheel &other);
+    TimerWheel &operator=(const TimerWheel &other);
+    ~TimerWheel();
+
+    void schedule(Timer &timer, long long delayInMillis);
+    void advance(long long now);
+    Timer *popExpired();
+    int nextTimeout(long long now) const;
+    void clear();
+
+   private:
+    long long currentTick;
+    std::vector<Timer> slots;
+    Timer expired;
+
+    void init();
+    void insert(Timer &timer);
+    void cascade(int level);
+    bool isEmpty() const;
+    static size_t slotIndex(int level, long long tick);
+    static void initList(Timer &head);
+    static void link(Timer &head, Timer &timer);
+};
@@ -3,14 +3,15 @@
 #include <vector>
 
 #include "Config.hpp"
+#include "EventLoop.hpp"
+#include "FdRegistry.hpp"
 #include "Logger.hpp"
+#include "ProcessReaper.hpp"
 #include "ServerManager.hpp"
+#include "TimerWheel.hpp"
 
 class WebServer {
    public:
-    static const size_t MAX_EVENTS;
-    static const size_t POLL_TIMEOUT;
-
     WebServer();
     WebServer(const Config &config);
     WebServer(const WebServer &other);
@@ -24,12 +25,17 @@ class WebServer {
    private:
     Logger logger;
 
-    std::vector<struct pollfd> fds;
+    std::string eventBackend;
+    EventLoop *eventLoop;
+    FdRegistry registry;
+    TimerWheel timers;
+    ProcessReaper reaper;
     std::vector<ServerManager> servers;
 
     static void verifyDuplicatedServers(std::vector<ServerConfig> serversConfig);
-    std::vector<ServerManager>::iterator findServerFd(int fd);
+    void handleEvent(const struct pollfd &event);
+    void acceptConnections(ServerManager &server);
+    void reapProcesses();
+    void handleTimeout(const Timer &timer, std::vector<int> &fdsToRemove);
     void removeClient(int clientfd);
-    std::vector<ServerManager>::iterator findServerClientFd(int clientFd);
-    std::vector<ServerManager>::iterator findServerClientPipeOutput(int clientFd);
 };
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// 256 entry membership table, lookups cost one load per byte whatever the size of the set
+class CharTable {
+   public:
+    static const size_t MAX_VECTOR_CHARACTERS;
+    static const size_t MAX_VECTOR_RANGES;
+
+    CharTable();
+    CharTable(const std::string &characters);
+    CharTable(const CharTable &other);
+    CharTable &operator=(const CharTable &other);
+    ~CharTable();
+
+    bool contains(unsigned char c) const;
+    size_t find(const std::string &str, size_t pos = 0) const;
+    size_t findFirstNotOf(const std::string &str, size_t pos = 0) const;
+    size_t findFirstNotOf(const char *data, size_t length) const;
+
+   private:
+    bool table[256];
+    // Small sets, such as delimiters, are also searched 16 bytes at a time, see make bench
+    char characters[4];
+    size_t size;
+    // The set as runs of consecutive bytes, a class made of a few runs is validated 16 bytes at a time
+    unsigned char rangeStarts[8];
+    unsigned char rangeSpans[8];
+    size_t rangeCount;
+
+    void buildRanges();
+    size_t findVector(const char *data, size_t length) const;
+    size_t findNotInRangesVector(const char *data, size_t length) const;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Immutable content shared by reference count, freed with the last holder. A cache keeps one while
+// every response still sending the content keeps another, so evicting it never frees bytes in flight
+class SharedBuffer {
+   public:
+    SharedBuffer();
+    // Takes the content of data without copying it, data is left empty
+    explicit SharedBuffer(std::string &data);
+    SharedBuffer(const SharedBuffer &other);
+    SharedBuffer &operator=(const SharedBuffer &other);
+    ~SharedBuffer();
+
+    // An empty string when nothing is held
+    const std::string &get() const;
+    size_t size() const;
+    bool empty() const;
+
+   private:
+    struct Block {
+        std::string data;
+        size_t references;
+    };
+
+    Block *block;
+
+    void release();
+};
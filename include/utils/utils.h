@@ -1,7 +1,10 @@
 #pragma once
 
+#include <sys/stat.h>
+
 #include <cerrno>
 #include <cstring>
+#include <ctime>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -15,3 +18,8 @@ std::string numberToString(long number);
 std::runtime_error createError(const std::string &error);
 void lowercase(std::string &str);
 std::string createPath(const std::string &root, const std::string &uri);
+long long getCurrentTimeMillis();
+long getMtimeNsec(const struct stat &info);
+std::string formatHttpDate(time_t time);
+bool parseHttpDate(const std::string &date, time_t &time);
+bool gzipCompress(const std::string &input, int level, std::string &output);
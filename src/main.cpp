@@ -1,6 +1,9 @@
+#include <csignal>
+
+#include "Client.hpp"
 #include "Config.hpp"
 #include "Logger.hpp"
-#include "WebServer.hpp"
+#include "MasterProcess.hpp"
 
 int main(int argc, char **argv) {
     if (argc != 2) {
@@ -9,12 +12,14 @@ int main(int argc, char **argv) {
     }
 
     Logger logger("Webserv");
+    // Writes to a peer that went away must fail with EPIPE instead of killing the server
+    std::signal(SIGPIPE, SIG_IGN);
+    Client::loadInheritedEnvironment();
     try {
         Config config;
         config.loadConfig(argv[1]);
-        WebServer webServer(config);
-        webServer.setupServers();
-        webServer.runServers();
+        MasterProcess master(config);
+        return (master.run());
     } catch (std::exception &e) {
         logger.error() << "Error: " << e.what() << std::endl;
         return (1);
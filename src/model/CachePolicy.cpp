@@ -0,0 +1,117 @@
+#include "CachePolicy.hpp"
+
+#include <cctype>
+#include <ctime>
+
+#include "utils.h"
+
+const std::string CachePolicy::EXPIRES_KEY = "expires";
+const std::string CachePolicy::CACHE_CONTROL_KEY = "cache_control";
+const long CachePolicy::MAX_EXPIRES = 315360000;  // 10 years, in seconds
+
+CachePolicy::CachePolicy() : configured(false), expiry(EXPIRES_OFF), maxAge(0), cacheControl("") {}
+
+CachePolicy::CachePolicy(const CachePolicy& other) : configured(other.configured), expiry(other.expiry), maxAge(other.maxAge), cacheControl(other.cacheControl) {}
+
+CachePolicy& CachePolicy::operator=(const CachePolicy& other) {
+    if (this != &other) {
+        configured = other.configured;
+        expiry = other.expiry;
+        maxAge = other.maxAge;
+        cacheControl = other.cacheControl;
+    }
+    return *this;
+}
+
+CachePolicy::~CachePolicy() {}
+
+bool CachePolicy::isDirective(const std::string& key) {
+    return (key == EXPIRES_KEY || key == CACHE_CONTROL_KEY);
+}
+
+// A number of seconds, or of minutes, hours or days with an m, h or d suffix
+bool CachePolicy::parseDuration(const std::string& value, long& seconds) {
+    static const std::string units = "smhd";
+    static const long multipliers[] = {1, 60, 60 * 60, 24 * 60 * 60};
+
+    size_t digits = 0;
+    seconds = 0;
+    while (digits < value.size() && std::isdigit(static_cast<unsigned char>(value[digits]))) {
+        seconds = seconds * 10 + (value[digits] - '0');
+        if (seconds > MAX_EXPIRES) {
+            return (false);
+        }
+        ++digits;
+    }
+    if (digits == 0 || digits + 1 < value.size()) {
+        return (false);
+    }
+    if (digits < value.size()) {
+        size_t unit = units.find(value[digits]);
+        if (unit == std::string::npos) {
+            return (false);
+        }
+        seconds *= multipliers[unit];
+    }
+    return (seconds <= MAX_EXPIRES);
+}
+
+bool CachePolicy::set(const std::string& key, const std::vector<std::string>& values) {
+    configured = true;
+    if (values.empty()) {
+        return (false);
+    }
+
+    if (key == CACHE_CONTROL_KEY) {
+        cacheControl.clear();
+        for (std::vector<std::string>::const_iterator it = values.begin(); it != values.end(); ++it) {
+            std::string value = *it;
+            while (!value.empty() && value[value.size() - 1] == ',') {
+                value.erase(value.size() - 1);
+            }
+            if (!value.empty()) {
+                cacheControl += (cacheControl.empty() ? "" : ", ") + value;
+            }
+        }
+        return (!cacheControl.empty());
+    }
+
+    if (key != EXPIRES_KEY || values.size() != 1) {
+        return (false);
+    }
+    const std::string& value = values.front();
+    if (value == "off") {
+        expiry = EXPIRES_OFF;
+    } else if (value == "epoch") {
+        expiry = EXPIRES_EPOCH;
+    } else if (value == "max") {
+        expiry = EXPIRES_AFTER;
+        maxAge = MAX_EXPIRES;
+    } else if (parseDuration(value, maxAge)) {
+        expiry = EXPIRES_AFTER;
+    } else {
+        return (false);
+    }
+    return (true);
+}
+
+bool CachePolicy::isConfigured() const { return configured; }
+
+void CachePolicy::addHeaders(std::map<std::string, std::string>& headers) const {
+    std::string control;
+    if (expiry == EXPIRES_EPOCH) {
+        headers["Expires"] = formatHttpDate(1);
+        control = "no-cache";
+    } else if (expiry == EXPIRES_AFTER) {
+        // A fresh response is used without asking the server at all, until it expires
+        headers["Expires"] = formatHttpDate(std::time(NULL) + maxAge);
+        control = "max-age=" + numberToString(maxAge);
+    }
+
+    if (!cacheControl.empty()) {
+        control += (control.empty() ? "" : ", ") + cacheControl;
+    }
+    if (!control.empty()) {
+        headers["Cache-Control"] = control;
+    }
+}
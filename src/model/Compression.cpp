@@ -0,0 +1,94 @@
+#include "Compression.hpp"
+
+#include <cstdlib>
+
+#include "utils.h"
+
+const std::string Compression::GZIP_KEY = "gzip";
+const std::string Compression::GZIP_STATIC_KEY = "gzip_static";
+const std::string Compression::GZIP_COMP_LEVEL_KEY = "gzip_comp_level";
+const std::string Compression::GZIP_MIN_LENGTH_KEY = "gzip_min_length";
+const int Compression::DEFAULT_LEVEL = 6;
+const size_t Compression::DEFAULT_MIN_LENGTH = 256;  // bytes
+
+GeneratedPage::GeneratedPage() : content(""), gzipContents() {}
+
+GeneratedPage::GeneratedPage(const std::string& content) : content(content), gzipContents() {}
+
+Compression::Compression() : configured(false), enabled(false), staticEnabled(false), level(DEFAULT_LEVEL), minLength(DEFAULT_MIN_LENGTH) {}
+
+Compression::Compression(const Compression& other) : configured(other.configured), enabled(other.enabled), staticEnabled(other.staticEnabled), level(other.level), minLength(other.minLength) {}
+
+Compression& Compression::operator=(const Compression& other) {
+    if (this != &other) {
+        configured = other.configured;
+        enabled = other.enabled;
+        staticEnabled = other.staticEnabled;
+        level = other.level;
+        minLength = other.minLength;
+    }
+    return *this;
+}
+
+Compression::~Compression() {}
+
+bool Compression::isDirective(const std::string& key) {
+    return (key == GZIP_KEY || key == GZIP_STATIC_KEY || key == GZIP_COMP_LEVEL_KEY || key == GZIP_MIN_LENGTH_KEY);
+}
+
+bool Compression::set(const std::string& key, const std::string& value) {
+    configured = true;
+    if (key == GZIP_KEY || key == GZIP_STATIC_KEY) {
+        if (value != "on" && value != "off") {
+            return (false);
+        }
+        (key == GZIP_KEY ? enabled : staticEnabled) = (value == "on");
+        return (true);
+    }
+
+    char* end;
+    long number = std::strtol(value.c_str(), &end, 10);
+    if (*end != '\0' || value.empty()) {
+        return (false);
+    }
+    if (key == GZIP_COMP_LEVEL_KEY) {
+        if (number < 1 || number > 9) {
+            return (false);
+        }
+        level = number;
+    } else if (key == GZIP_MIN_LENGTH_KEY) {
+        if (number < 0) {
+            return (false);
+        }
+        minLength = number;
+    } else {
+        return (false);
+    }
+    return (true);
+}
+
+bool Compression::isConfigured() const { return configured; }
+bool Compression::isEnabled() const { return enabled; }
+bool Compression::isStaticEnabled() const { return staticEnabled; }
+int Compression::getLevel() const { return level; }
+size_t Compression::getMinLength() const { return minLength; }
+
+bool Compression::shouldCompress(const std::string& mimeType, size_t size) const {
+    return (enabled && size >= minLength && isCompressible(mimeType));
+}
+
+const std::string* Compression::getGzip(const GeneratedPage& page) const {
+    std::map<int, std::string>::iterator found = page.gzipContents.find(level);
+    if (found == page.gzipContents.end()) {
+        found = page.gzipContents.insert(std::make_pair(level, std::string())).first;
+        if (!gzipCompress(page.content, level, found->second) || found->second.size() >= page.content.size()) {
+            std::string().swap(found->second);
+        }
+    }
+    return (found->second.empty() ? NULL : &found->second);
+}
+
+// Images and videos are already compressed, only text gains from it
+bool Compression::isCompressible(const std::string& mimeType) {
+    return (mimeType.compare(0, 5, "text/") == 0 || mimeType == "application/javascript" || mimeType == "application/json" || mimeType == "application/xml" || mimeType == "image/svg+xml");
+}
@@ -1,10 +1,17 @@
 #include "Configurations.hpp"
 
-Configurations::Configurations() : isAutoindex(false), clientBodySize(0), redirect(""), root(""), index(""), methods(), errorPages(), cgiPaths() {}
+#include <fstream>
+#include <sstream>
 
-Configurations::Configurations(bool isAutoindex, size_t clientBodySize, const std::string& redirect, const std::string& root, const std::string& index, const std::vector<Method>& methods, const std::vector<std::pair<size_t, std::string> >& errorPages, const std::map<std::string, std::string>& cgiPaths) : isAutoindex(isAutoindex), clientBodySize(clientBodySize), redirect(redirect), root(root), index(index), methods(methods), errorPages(errorPages), cgiPaths(cgiPaths) {}
+#include "utils.h"
 
-Configurations::Configurations(const Configurations& other) : isAutoindex(other.isAutoindex), clientBodySize(other.clientBodySize), redirect(other.redirect), root(other.root), index(other.index), methods(other.methods), errorPages(other.errorPages), cgiPaths(other.cgiPaths) {}
+Configurations::Configurations() : isAutoindex(false), clientBodySize(0), redirect(""), root(""), index(""), methods(), errorPages(), cgiPaths(), fastCgiPass(""), compression(), cachePolicy() {}
+
+Configurations::Configurations(bool isAutoindex, size_t clientBodySize, const std::string& redirect, const std::string& root, const std::string& index, const std::vector<Method>& methods, const std::vector<std::pair<size_t, std::string> >& errorPages, const std::map<std::string, std::string>& cgiPaths, const std::string& fastCgiPass, const Compression& compression, const CachePolicy& cachePolicy) : isAutoindex(isAutoindex), clientBodySize(clientBodySize), redirect(redirect), root(root), index(index), methods(methods), errorPages(), cgiPaths(cgiPaths), fastCgiPass(fastCgiPass), compression(compression), cachePolicy(cachePolicy) {
+    loadErrorPages(errorPages);
+}
+
+Configurations::Configurations(const Configurations& other) : isAutoindex(other.isAutoindex), clientBodySize(other.clientBodySize), redirect(other.redirect), root(other.root), index(other.index), methods(other.methods), errorPages(other.errorPages), cgiPaths(other.cgiPaths), fastCgiPass(other.fastCgiPass), compression(other.compression), cachePolicy(other.cachePolicy) {}
 
 Configurations& Configurations::operator=(const Configurations& other) {
     if (this != &other) {
@@ -16,6 +23,9 @@ Configurations& Configurations::operator=(const Configurations& other) {
         methods = other.methods;
         errorPages = other.errorPages;
         cgiPaths = other.cgiPaths;
+        fastCgiPass = other.fastCgiPass;
+        compression = other.compression;
+        cachePolicy = other.cachePolicy;
     }
     return *this;
 }
@@ -28,5 +38,20 @@ const std::string& Configurations::getRedirect() const { return redirect; }
 const std::string& Configurations::getRoot() const { return root; }
 const std::string& Configurations::getIndex() const { return index; }
 const std::vector<Method>& Configurations::getMethods() const { return methods; }
-const std::vector<std::pair<size_t, std::string> >& Configurations::getErrorPages() const { return errorPages; }
+const std::map<size_t, GeneratedPage>& Configurations::getErrorPages() const { return errorPages; }
 const std::map<std::string, std::string>& Configurations::getCgiPaths() const { return cgiPaths; }
+const std::string& Configurations::getFastCgiPass() const { return fastCgiPass; }
+const Compression& Configurations::getCompression() const { return compression; }
+const CachePolicy& Configurations::getCachePolicy() const { return cachePolicy; }
+
+// A page that can't be read is left out, its errors get the default page instead
+void Configurations::loadErrorPages(const std::vector<std::pair<size_t, std::string> >& errorPagePaths) {
+    for (std::vector<std::pair<size_t, std::string> >::const_iterator it = errorPagePaths.begin(); it != errorPagePaths.end(); ++it) {
+        std::ifstream file(createPath(root, it->second).c_str());
+        if (file.is_open()) {
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+            errorPages[it->first] = GeneratedPage(buffer.str());
+        }
+    }
+}
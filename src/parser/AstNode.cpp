@@ -15,7 +15,14 @@ AstNode &AstNode::operator=(const AstNode &other) {
         key = other.key;
         values = other.values;
         isLeaf = other.isLeaf;
-        children = other.children;
+        for (std::vector<AstNode *>::iterator it = children.begin(); it != children.end(); ++it) {
+            delete (*it);
+        }
+        children.clear();
+        // Children are owned, so they are copied instead of shared
+        for (std::vector<AstNode *>::const_iterator it = other.children.begin(); it != other.children.end(); ++it) {
+            children.push_back(new AstNode(*(*it)));
+        }
     }
     return (*this);
 }
@@ -1,14 +1,21 @@
 #include "Config.hpp"
 
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <fstream>
 #include <iostream>
 #include <sstream>
 
+#include "EventLoop.hpp"
+
 const std::string Config::SERVER_KEY = "server";
+const std::string Config::EVENT_BACKEND_KEY = "event_backend";
+const std::string Config::WORKER_PROCESSES_KEY = "worker_processes";
+const std::string Config::WORKER_CPU_AFFINITY_KEY = "worker_cpu_affinity";
+const size_t Config::MAX_WORKER_PROCESSES = 1024;
 
-Config::Config() : logger(Logger("CONFIG")), rootAstNode(AstNode(Token("main", -1), false)), tokens(std::vector<Token>()), servers(std::vector<ServerConfig>()) {}
+Config::Config() : logger(Logger("CONFIG")), rootAstNode(AstNode(Token("main", -1), false)), tokens(std::vector<Token>()), servers(std::vector<ServerConfig>()), eventBackend(EventLoop::DEFAULT_BACKEND), workerProcesses(1), workerCpuAffinity(false) {}
 
 Config::Config(const Config &other) {
     *this = other;
@@ -20,6 +27,9 @@ Config &Config::operator=(const Config &other) {
         rootAstNode = other.rootAstNode;
         tokens = other.tokens;
         servers = other.servers;
+        eventBackend = other.eventBackend;
+        workerProcesses = other.workerProcesses;
+        workerCpuAffinity = other.workerCpuAffinity;
     }
     return (*this);
 }
@@ -136,12 +146,81 @@ void Config::parseServers() {
             ServerConfig serverConfig;
             serverConfig.parseServer(*(*it));
             servers.push_back(serverConfig);
+        } else if ((*it)->getKey().getValue() == Config::EVENT_BACKEND_KEY && (*it)->getIsLeaf()) {
+            parseEventBackend(*(*it));
+        } else if ((*it)->getKey().getValue() == Config::WORKER_PROCESSES_KEY && (*it)->getIsLeaf()) {
+            parseWorkerProcesses(*(*it));
+        } else if ((*it)->getKey().getValue() == Config::WORKER_CPU_AFFINITY_KEY && (*it)->getIsLeaf()) {
+            parseWorkerCpuAffinity(*(*it));
         } else {
             throw std::runtime_error("Invalid block with name '" + (*it)->getKey().getValue() + "' in config file at line: " + numberToString((*it)->getKey().getLine()));
         }
     }
+
+    if (servers.empty()) {
+        throw std::runtime_error("No server block found in config file");
+    }
+}
+
+void Config::parseEventBackend(const AstNode &node) {
+    if (node.getValues().size() != 1) {
+        throw std::runtime_error("Event backend attribute expected one value at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    std::string value = node.getValues().front().getValue();
+    if (!EventLoop::isValidBackend(value)) {
+        throw std::runtime_error("Event backend must be 'poll', 'epoll' or 'epoll_et' at line: " + numberToString(node.getKey().getLine()));
+    }
+    eventBackend = value;
+}
+
+void Config::parseWorkerProcesses(const AstNode &node) {
+    if (node.getValues().size() != 1) {
+        throw std::runtime_error("Worker processes attribute expected one value at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    std::string value = node.getValues().front().getValue();
+    if (value == "auto") {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workerProcesses = (cpus > 0) ? cpus : 1;
+        return;
+    }
+
+    char *end;
+    long workers = std::strtol(value.c_str(), &end, 10);
+    if (*end != '\0' || workers < 1 || static_cast<size_t>(workers) > MAX_WORKER_PROCESSES) {
+        throw std::runtime_error("Worker processes attribute must be 'auto' or a number between 1 and " + numberToString(MAX_WORKER_PROCESSES) + " at line: " + numberToString(node.getKey().getLine()));
+    }
+    workerProcesses = workers;
+}
+
+void Config::parseWorkerCpuAffinity(const AstNode &node) {
+    if (node.getValues().size() != 1) {
+        throw std::runtime_error("Worker cpu affinity attribute expected one value at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    std::string value = node.getValues().front().getValue();
+    if (value == "on") {
+        workerCpuAffinity = true;
+    } else if (value == "off") {
+        workerCpuAffinity = false;
+    } else {
+        throw std::runtime_error("Worker cpu affinity attribute must be 'on' or 'off' at line: " + numberToString(node.getKey().getLine()));
+    }
 }
 
 const std::vector<ServerConfig> &Config::getServers() const {
     return (servers);
 }
+
+const std::string &Config::getEventBackend() const {
+    return (eventBackend);
+}
+
+size_t Config::getWorkerProcesses() const {
+    return (workerProcesses);
+}
+
+bool Config::getWorkerCpuAffinity() const {
+    return (workerCpuAffinity);
+}
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 
+#include "FastCgi.hpp"
 #include "HttpRequest.hpp"
 
 const size_t LocationConfig::DEFAULT_CLIENT_BODY_SIZE = 1000000;
@@ -14,8 +15,9 @@ const std::string LocationConfig::ERROR_PAGE_KEY = "error_page";
 const std::string LocationConfig::AUTOINDEX_KEY = "autoindex";
 const std::string LocationConfig::DEFAULT_INDEX = "index.html";
 const std::string LocationConfig::CGI_PATH_KEY = "cgi_path";
+const std::string LocationConfig::FASTCGI_PASS_KEY = "fastcgi_pass";
 
-LocationConfig::LocationConfig() : logger(Logger("LOCATION_CONFIG")), path(""), root(""), index(DEFAULT_INDEX), redirect(""), clientBodySize(DEFAULT_CLIENT_BODY_SIZE), methods(std::vector<Method>()), errorPages(std::vector<std::pair<size_t, std::string> >()), autoindex(false), cgiPaths() {}
+LocationConfig::LocationConfig() : logger(Logger("LOCATION_CONFIG")), path(""), root(""), index(DEFAULT_INDEX), redirect(""), clientBodySize(DEFAULT_CLIENT_BODY_SIZE), methods(std::vector<Method>()), errorPages(std::vector<std::pair<size_t, std::string> >()), autoindex(false), cgiPaths(), fastCgiPass(""), compression(), cachePolicy() {}
 
 LocationConfig::LocationConfig(const LocationConfig& other) {
     *this = other;
@@ -33,6 +35,9 @@ LocationConfig& LocationConfig::operator=(const LocationConfig& other) {
         errorPages = other.errorPages;
         autoindex = other.autoindex;
         cgiPaths = other.cgiPaths;
+        fastCgiPass = other.fastCgiPass;
+        compression = other.compression;
+        cachePolicy = other.cachePolicy;
     }
     return (*this);
 }
@@ -49,7 +54,7 @@ void LocationConfig::parseLocation(const AstNode& node) {
     }
     path = node.getValues().front().getValue();
 
-    if (path.find_first_not_of(HttpRequest::URI_CHARACTERS) != std::string::npos) {
+    if (HttpRequest::verifyUri(path)) {
         throw std::runtime_error("Location path contains invalid characters at line: " + numberToString(node.getKey().getLine()));
     }
 
@@ -77,6 +82,12 @@ void LocationConfig::parseLocation(const AstNode& node) {
             parseAutoindex(*(*it));
         } else if (attribute == LocationConfig::CGI_PATH_KEY) {
             parseCgiPath(*(*it));
+        } else if (attribute == LocationConfig::FASTCGI_PASS_KEY) {
+            parseFastCgiPass(*(*it));
+        } else if (Compression::isDirective(attribute)) {
+            parseCompression(*(*it));
+        } else if (CachePolicy::isDirective(attribute)) {
+            parseCachePolicy(*(*it));
         } else {
             throw std::runtime_error("Unknown attribute '" + attribute + "' in server block at line: " + numberToString(node.getKey().getLine()));
         }
@@ -118,7 +129,7 @@ void LocationConfig::parseRedirect(const AstNode& node) {
 
     redirect = node.getValues().front().getValue();
 
-    if (redirect.find_first_not_of(HttpRequest::URI_CHARACTERS) != std::string::npos) {
+    if (HttpRequest::verifyUri(redirect)) {
         throw std::runtime_error("Redirect attribute contains invalid characters at line: " + numberToString(node.getKey().getLine()));
     }
 }
@@ -233,6 +244,52 @@ void LocationConfig::parseCgiPath(const AstNode& node) {
     }
 }
 
+void LocationConfig::parseFastCgiPass(const AstNode& node) {
+    if (!node.getIsLeaf()) {
+        throw std::runtime_error("Fastcgi pass attribute can't have children at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    if (node.getValues().size() != 1) {
+        throw std::runtime_error("Fastcgi pass attribute expected one value at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    fastCgiPass = node.getValues().front().getValue();
+
+    if (!FastCgiPool::isValidAddress(fastCgiPass)) {
+        throw std::runtime_error("Fastcgi pass attribute must be unix:path or ip:port at line: " + numberToString(node.getKey().getLine()));
+    }
+}
+
+void LocationConfig::parseCompression(const AstNode& node) {
+    std::string key = node.getKey().getValue();
+    if (!node.getIsLeaf()) {
+        throw std::runtime_error("Attribute " + key + " can't have children at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    if (node.getValues().size() != 1) {
+        throw std::runtime_error("Attribute " + key + " expected one value at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    if (!compression.set(key, node.getValues().front().getValue())) {
+        throw std::runtime_error("Attribute " + key + " has an invalid value at line: " + numberToString(node.getKey().getLine()));
+    }
+}
+
+void LocationConfig::parseCachePolicy(const AstNode& node) {
+    std::string key = node.getKey().getValue();
+    if (!node.getIsLeaf()) {
+        throw std::runtime_error("Attribute " + key + " can't have children at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    std::vector<std::string> values;
+    for (std::vector<Token>::const_iterator it = node.getValues().begin(); it != node.getValues().end(); ++it) {
+        values.push_back((*it).getValue());
+    }
+    if (!cachePolicy.set(key, values)) {
+        throw std::runtime_error("Attribute " + key + " has an invalid value at line: " + numberToString(node.getKey().getLine()));
+    }
+}
+
 const std::string& LocationConfig::getPath() const {
     return (path);
 }
@@ -268,3 +325,28 @@ bool LocationConfig::getAutoindex() const {
 const std::map<std::string, std::string>& LocationConfig::getCgiPaths() const {
     return (cgiPaths);
 }
+
+const std::string& LocationConfig::getFastCgiPass() const {
+    return (fastCgiPass);
+}
+
+const Compression& LocationConfig::getCompression() const {
+    return (compression);
+}
+
+const CachePolicy& LocationConfig::getCachePolicy() const {
+    return (cachePolicy);
+}
+
+// A location without any gzip directive compresses like its server
+void LocationConfig::inheritCompression(const Compression& serverCompression) {
+    if (!compression.isConfigured()) {
+        compression = serverCompression;
+    }
+}
+
+void LocationConfig::inheritCachePolicy(const CachePolicy& serverCachePolicy) {
+    if (!cachePolicy.isConfigured()) {
+        cachePolicy = serverCachePolicy;
+    }
+}
@@ -7,8 +7,14 @@
 const std::string ServerConfig::LISTEN_KEY = "listen";
 const std::string ServerConfig::SERVER_NAME_KEY = "server_name";
 const std::string ServerConfig::LOCATION_KEY = "location";
+const std::string ServerConfig::KEEPALIVE_TIMEOUT_KEY = "keepalive_timeout";
+const std::string ServerConfig::KEEPALIVE_REQUESTS_KEY = "keepalive_requests";
+const std::string ServerConfig::FILE_CACHE_SIZE_KEY = "file_cache_size";
+const size_t ServerConfig::DEFAULT_KEEPALIVE_TIMEOUT = 75;  // seconds
+const size_t ServerConfig::DEFAULT_KEEPALIVE_REQUESTS = 100;
+const size_t ServerConfig::DEFAULT_FILE_CACHE_SIZE = 1024 * 1024 * 8;  // 8 MB
 
-ServerConfig::ServerConfig() : logger(Logger("SERVER_CONFIG")), port(-1), host(INADDR_ANY), name(""), root(""), index(LocationConfig::DEFAULT_INDEX), clientBodySize(LocationConfig::DEFAULT_CLIENT_BODY_SIZE), methods(std::vector<Method>()), locations(std::vector<LocationConfig>()), errorPages(std::vector<std::pair<size_t, std::string> >()), autoindex(false) {}
+ServerConfig::ServerConfig() : logger(Logger("SERVER_CONFIG")), port(-1), host(INADDR_ANY), name(""), root(""), index(LocationConfig::DEFAULT_INDEX), clientBodySize(LocationConfig::DEFAULT_CLIENT_BODY_SIZE), methods(std::vector<Method>()), locations(std::vector<LocationConfig>()), errorPages(std::vector<std::pair<size_t, std::string> >()), autoindex(false), keepaliveTimeout(DEFAULT_KEEPALIVE_TIMEOUT), keepaliveRequests(DEFAULT_KEEPALIVE_REQUESTS), fileCacheSize(DEFAULT_FILE_CACHE_SIZE), compression(), cachePolicy() {}
 
 ServerConfig::ServerConfig(const ServerConfig& other) {
     *this = other;
@@ -27,6 +33,11 @@ ServerConfig& ServerConfig::operator=(const ServerConfig& other) {
         methods = other.methods;
         errorPages = other.errorPages;
         autoindex = other.autoindex;
+        keepaliveTimeout = other.keepaliveTimeout;
+        keepaliveRequests = other.keepaliveRequests;
+        fileCacheSize = other.fileCacheSize;
+        compression = other.compression;
+        cachePolicy = other.cachePolicy;
     }
     return (*this);
 }
@@ -70,11 +81,26 @@ void ServerConfig::parseServer(const AstNode& node) {
             parseErrorPage(*(*it));
         } else if (attribute == LocationConfig::AUTOINDEX_KEY) {
             parseAutoindex(*(*it));
+        } else if (attribute == ServerConfig::KEEPALIVE_TIMEOUT_KEY) {
+            parseKeepaliveTimeout(*(*it));
+        } else if (attribute == ServerConfig::KEEPALIVE_REQUESTS_KEY) {
+            parseKeepaliveRequests(*(*it));
+        } else if (attribute == ServerConfig::FILE_CACHE_SIZE_KEY) {
+            parseFileCacheSize(*(*it));
+        } else if (Compression::isDirective(attribute)) {
+            parseCompression(*(*it));
+        } else if (CachePolicy::isDirective(attribute)) {
+            parseCachePolicy(*(*it));
         } else {
             throw std::runtime_error("Unknown attribute '" + attribute + "' in server block at line: " + numberToString(node.getKey().getLine()));
         }
     }
 
+    for (std::vector<LocationConfig>::iterator it = locations.begin(); it != locations.end(); ++it) {
+        (*it).inheritCompression(compression);
+        (*it).inheritCachePolicy(cachePolicy);
+    }
+
     validMinimumConfig();
     verifyDuplicatedLocations();
 }
@@ -255,6 +281,94 @@ void ServerConfig::parseAutoindex(const AstNode& node) {
     }
 }
 
+void ServerConfig::parseKeepaliveTimeout(const AstNode& node) {
+    if (!node.getIsLeaf()) {
+        throw std::runtime_error("Keepalive timeout attribute can't have children at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    if (node.getValues().size() != 1) {
+        throw std::runtime_error("Keepalive timeout attribute expected one value at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    std::string value = node.getValues().front().getValue();
+    char* end;
+    long timeout = std::strtol(value.c_str(), &end, 10);
+    if (*end != '\0' || timeout < 0) {
+        throw std::runtime_error("Keepalive timeout attribute must be a number of seconds at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    keepaliveTimeout = timeout;
+}
+
+void ServerConfig::parseKeepaliveRequests(const AstNode& node) {
+    if (!node.getIsLeaf()) {
+        throw std::runtime_error("Keepalive requests attribute can't have children at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    if (node.getValues().size() != 1) {
+        throw std::runtime_error("Keepalive requests attribute expected one value at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    std::string value = node.getValues().front().getValue();
+    char* end;
+    long requests = std::strtol(value.c_str(), &end, 10);
+    if (*end != '\0' || requests < 1) {
+        throw std::runtime_error("Keepalive requests attribute must be a positive number at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    keepaliveRequests = requests;
+}
+
+// Bytes of file content kept in memory, 0 turns the cache off
+void ServerConfig::parseFileCacheSize(const AstNode& node) {
+    if (!node.getIsLeaf()) {
+        throw std::runtime_error("File cache size attribute can't have children at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    if (node.getValues().size() != 1) {
+        throw std::runtime_error("File cache size attribute expected one value at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    std::string value = node.getValues().front().getValue();
+    char* end;
+    long size = std::strtol(value.c_str(), &end, 10);
+    if (*end != '\0' || size < 0) {
+        throw std::runtime_error("File cache size attribute must be a number of bytes at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    fileCacheSize = size;
+}
+
+void ServerConfig::parseCompression(const AstNode& node) {
+    std::string key = node.getKey().getValue();
+    if (!node.getIsLeaf()) {
+        throw std::runtime_error("Attribute " + key + " can't have children at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    if (node.getValues().size() != 1) {
+        throw std::runtime_error("Attribute " + key + " expected one value at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    if (!compression.set(key, node.getValues().front().getValue())) {
+        throw std::runtime_error("Attribute " + key + " has an invalid value at line: " + numberToString(node.getKey().getLine()));
+    }
+}
+
+void ServerConfig::parseCachePolicy(const AstNode& node) {
+    std::string key = node.getKey().getValue();
+    if (!node.getIsLeaf()) {
+        throw std::runtime_error("Attribute " + key + " can't have children at line: " + numberToString(node.getKey().getLine()));
+    }
+
+    std::vector<std::string> values;
+    for (std::vector<Token>::const_iterator it = node.getValues().begin(); it != node.getValues().end(); ++it) {
+        values.push_back((*it).getValue());
+    }
+    if (!cachePolicy.set(key, values)) {
+        throw std::runtime_error("Attribute " + key + " has an invalid value at line: " + numberToString(node.getKey().getLine()));
+    }
+}
+
 int ServerConfig::getPort() const {
     return (port);
 }
@@ -294,3 +408,23 @@ const std::vector<std::pair<size_t, std::string> >& ServerConfig::getErrorPages(
 bool ServerConfig::getAutoindex() const {
     return (autoindex);
 }
+
+size_t ServerConfig::getKeepaliveTimeout() const {
+    return (keepaliveTimeout);
+}
+
+size_t ServerConfig::getKeepaliveRequests() const {
+    return (keepaliveRequests);
+}
+
+size_t ServerConfig::getFileCacheSize() const {
+    return (fileCacheSize);
+}
+
+const Compression& ServerConfig::getCompression() const {
+    return (compression);
+}
+
+const CachePolicy& ServerConfig::getCachePolicy() const {
+    return (cachePolicy);
+}
@@ -0,0 +1,355 @@
+#include "AutoindexCache.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+#include "utils.h"
+
+const size_t AutoindexCache::MAX_DIRECTORIES = 64;
+const size_t AutoindexCache::MAX_PAGES = 16;
+const size_t AutoindexCache::PAGE_SIZE = 1000;                     // entries
+const long long AutoindexCache::MAX_AGE_IN_MILLIS = 10 * 1000;  // 10 seconds
+
+AutoindexCache::AutoindexCache() : listings() {}
+
+// Listings are only filled while serving, a copy starts empty
+AutoindexCache::AutoindexCache(const AutoindexCache &other) : listings() {
+    (void)other;
+}
+
+AutoindexCache &AutoindexCache::operator=(const AutoindexCache &other) {
+    if (this != &other) {
+        listings.clear();
+    }
+    return (*this);
+}
+
+AutoindexCache::~AutoindexCache() {}
+
+// Adding, removing or renaming an entry changes the mtime of the directory, a file changed in place
+// doesn't, so its size and date are refreshed by the age limit instead
+DirectoryListing *AutoindexCache::getListing(const std::string &directoryPath) {
+    struct stat info;
+    if (stat(directoryPath.c_str(), &info) == -1 || !S_ISDIR(info.st_mode)) {
+        return (NULL);
+    }
+
+    long long now = getCurrentTimeMillis();
+    std::map<std::string, DirectoryListing>::iterator found = listings.find(directoryPath);
+    if (found != listings.end()) {
+        DirectoryListing &listing = found->second;
+        if (listing.mtime == info.st_mtime && listing.mtimeNsec == getMtimeNsec(info) && listing.inode == info.st_ino && now - listing.builtAt < MAX_AGE_IN_MILLIS) {
+            listing.usedAt = now;
+            return (&listing);
+        }
+    } else {
+        evict();
+        found = listings.insert(std::make_pair(directoryPath, DirectoryListing())).first;
+    }
+
+    DirectoryListing &listing = found->second;
+    if (!load(directoryPath, listing)) {
+        listings.erase(found);
+        return (NULL);
+    }
+    listing.builtAt = now;
+    listing.usedAt = now;
+    return (&listing);
+}
+
+static bool compareName(const DirectoryEntry &a, const DirectoryEntry &b) {
+    return (a.name < b.name);
+}
+
+// The directory's own mtime is taken before reading it, so a change made meanwhile triggers a rebuild
+bool AutoindexCache::load(const std::string &directoryPath, DirectoryListing &listing) {
+    int dirFd = open(directoryPath.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirFd == -1) {
+        return (false);
+    }
+    struct stat info;
+    DIR *dir = NULL;
+    if (fstat(dirFd, &info) == -1 || (dir = fdopendir(dirFd)) == NULL) {
+        close(dirFd);
+        return (false);
+    }
+
+    listing.entries.clear();
+    listing.pages.clear();
+    listing.mtime = info.st_mtime;
+    listing.mtimeNsec = getMtimeNsec(info);
+    listing.inode = info.st_ino;
+
+    // Entries are looked up relative to the open directory, without building their path
+    struct dirent *dent;
+    while ((dent = readdir(dir)) != NULL) {
+        if (dent->d_name[0] == '.') {
+            continue;
+        }
+        struct stat entryInfo;
+        if (fstatat(dirFd, dent->d_name, &entryInfo, 0) == -1) {
+            // Removed since it was read, or a dangling link
+            continue;
+        }
+        DirectoryEntry entry;
+        entry.name = dent->d_name;
+        entry.isDirectory = S_ISDIR(entryInfo.st_mode);
+        entry.mtime = entryInfo.st_mtime;
+        entry.size = entryInfo.st_size;
+        listing.entries.push_back(entry);
+    }
+    closedir(dir);
+
+    std::sort(listing.entries.begin(), listing.entries.end(), compareName);
+    return (true);
+}
+
+// The least recently used directory makes room for a new one
+void AutoindexCache::evict() {
+    if (listings.size() < MAX_DIRECTORIES) {
+        return;
+    }
+
+    std::map<std::string, DirectoryListing>::iterator oldest = listings.begin();
+    for (std::map<std::string, DirectoryListing>::iterator it = listings.begin(); it != listings.end(); ++it) {
+        if (it->second.usedAt < oldest->second.usedAt) {
+            oldest = it;
+        }
+    }
+    listings.erase(oldest);
+}
+
+// format=html|json, sort=name|size|mtime, order=asc|desc and page=N, anything else is ignored
+AutoindexCache::Options AutoindexCache::parseOptions(const std::string &query) {
+    Options options;
+    options.json = false;
+    options.sort = SORT_NAME;
+    options.descending = false;
+    options.page = 1;
+
+    std::vector<std::string> parameters;
+    split(query, '&', parameters);
+    for (std::vector<std::string>::iterator it = parameters.begin(); it != parameters.end(); ++it) {
+        size_t equal = it->find('=');
+        if (equal == std::string::npos) {
+            continue;
+        }
+        std::string key = it->substr(0, equal);
+        std::string value = it->substr(equal + 1);
+        if (key == "format") {
+            options.json = (value == "json");
+        } else if (key == "sort") {
+            options.sort = (value == "size") ? SORT_SIZE : (value == "mtime") ? SORT_MTIME : SORT_NAME;
+        } else if (key == "order") {
+            options.descending = (value == "desc");
+        } else if (key == "page") {
+            long page = std::atol(value.c_str());
+            options.page = (page > 0) ? page : 1;
+        }
+    }
+    return (options);
+}
+
+// Links between pages keep the sort order they were reached with
+std::string AutoindexCache::createQuery(const Options &options, size_t page) {
+    std::string query = "?";
+    if (options.sort == SORT_SIZE) {
+        query += "sort=size&";
+    } else if (options.sort == SORT_MTIME) {
+        query += "sort=mtime&";
+    }
+    if (options.descending) {
+        query += "order=desc&";
+    }
+    return (query + "page=" + numberToString(page));
+}
+
+static bool compareSize(const DirectoryEntry *a, const DirectoryEntry *b) {
+    if (a->isDirectory != b->isDirectory) {
+        return (a->isDirectory);
+    }
+    return (!a->isDirectory && a->size < b->size);
+}
+
+static bool compareMtime(const DirectoryEntry *a, const DirectoryEntry *b) {
+    return (a->mtime < b->mtime);
+}
+
+static void appendPadded(std::string &page, const std::string &text, size_t width, bool left) {
+    std::string padding(text.size() < width ? width - text.size() : 0, ' ');
+    page += left ? text + padding : padding + text;
+}
+
+// Names and uris are text to the page, never markup
+static void appendHtml(std::string &page, const std::string &text) {
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '&') {
+            page += "&amp;";
+        } else if (c == '<') {
+            page += "&lt;";
+        } else if (c == '>') {
+            page += "&gt;";
+        } else if (c == '"') {
+            page += "&quot;";
+        } else if (c == '\'') {
+            page += "&#39;";
+        } else {
+            page += c;
+        }
+    }
+}
+
+// A name in a link is a single relative path segment: what a segment can't hold is percent-encoded,
+// and a ':' would read as a scheme, so such a name is reached through "./"
+static void appendHref(std::string &page, const std::string &name, bool isDirectory) {
+    static const std::string SEGMENT_CHARACTERS = "-._~!$&()*+,;=:@";
+    static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+    std::string href = (name.find(':') != std::string::npos) ? "./" : "";
+    for (size_t i = 0; i < name.size(); ++i) {
+        unsigned char c = name[i];
+        if (std::isalnum(c) || SEGMENT_CHARACTERS.find(c) != std::string::npos) {
+            href += c;
+        } else {
+            href += '%';
+            href += HEX_DIGITS[c >> 4];
+            href += HEX_DIGITS[c & 0xF];
+        }
+    }
+    if (isDirectory) {
+        href += '/';
+    }
+    appendHtml(page, href);
+}
+
+void AutoindexCache::renderHtml(const std::vector<const DirectoryEntry *> &entries, const std::string &uri, const Options &options, size_t pageCount, std::string &page) {
+    page += "<html>\n";
+    page += "<head><title> Index of ";
+    appendHtml(page, uri);
+    page += "</title></head>\n";
+    page += "<body><h1>Index of ";
+    appendHtml(page, uri);
+    page += "</h1><hr><pre>\n";
+    page += "<a href='../'>../</a>\n";
+
+    for (std::vector<const DirectoryEntry *>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        const DirectoryEntry &entry = **it;
+        page += "<a href='";
+        appendHref(page, entry.name, entry.isDirectory);
+        page += "'>";
+        appendHtml(page, entry.name);
+        // The column is padded on the name as shown, its escapes take no room on screen
+        page += "</a>";
+        page.append(entry.name.size() + 4 < 50 ? 50 - entry.name.size() - 4 : 0, ' ');
+
+        char date[64];
+        std::strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S", std::gmtime(&entry.mtime));
+        page += date;
+        appendPadded(page, entry.isDirectory ? "-" : numberToString(entry.size), 30, false);
+        page += '\n';
+    }
+    page += "</pre><hr>";
+
+    if (pageCount > 1) {
+        if (options.page > 1) {
+            page += "<a href='" + createQuery(options, options.page - 1) + "'>previous</a> ";
+        }
+        page += "Page " + numberToString(options.page) + " of " + numberToString(pageCount);
+        if (options.page < pageCount) {
+            page += " <a href='" + createQuery(options, options.page + 1) + "'>next</a>";
+        }
+        page += "<hr>";
+    }
+    page += "</body></html>";
+}
+
+static void appendJsonString(std::string &page, const std::string &value) {
+    page += '"';
+    for (size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = value[i];
+        if (c == '"' || c == '\\') {
+            page += '\\';
+            page += c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::sprintf(escaped, "\\u%04x", c);
+            page += escaped;
+        } else {
+            page += c;
+        }
+    }
+    page += '"';
+}
+
+void AutoindexCache::renderJson(const std::vector<const DirectoryEntry *> &entries, std::string &page) {
+    page += "[";
+    for (std::vector<const DirectoryEntry *>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        const DirectoryEntry &entry = **it;
+        page += (it == entries.begin()) ? "\n{\"name\":" : ",\n{\"name\":";
+        appendJsonString(page, entry.name);
+        page += entry.isDirectory ? ",\"type\":\"directory\"" : ",\"type\":\"file\"";
+        page += ",\"mtime\":\"" + formatHttpDate(entry.mtime) + '"';
+        if (!entry.isDirectory) {
+            page += ",\"size\":" + numberToString(entry.size);
+        }
+        page += '}';
+    }
+    page += "\n]\n";
+}
+
+const GeneratedPage *AutoindexCache::getPage(const std::string &directoryPath, const std::string &uri, const std::string &query, bool &json) {
+    DirectoryListing *listing = getListing(directoryPath);
+    if (listing == NULL) {
+        return (NULL);
+    }
+
+    Options options = parseOptions(query);
+    json = options.json;
+    size_t pageCount = std::max(static_cast<size_t>(1), (listing->entries.size() + PAGE_SIZE - 1) / PAGE_SIZE);
+    if (options.page > pageCount) {
+        return (NULL);
+    }
+
+    // The same directory can be reached from several uris, each has its own title
+    std::string key = std::string(options.json ? "json " : "html ") + numberToString(options.sort) + (options.descending ? " desc " : " asc ") + numberToString(options.page) + ' ' + uri;
+    std::map<std::string, GeneratedPage>::iterator found = listing->pages.find(key);
+    if (found != listing->pages.end()) {
+        return (&found->second);
+    }
+
+    std::vector<const DirectoryEntry *> entries;
+    entries.reserve(listing->entries.size());
+    for (std::vector<DirectoryEntry>::const_iterator it = listing->entries.begin(); it != listing->entries.end(); ++it) {
+        entries.push_back(&(*it));
+    }
+    if (options.sort == SORT_SIZE) {
+        std::stable_sort(entries.begin(), entries.end(), compareSize);
+    } else if (options.sort == SORT_MTIME) {
+        std::stable_sort(entries.begin(), entries.end(), compareMtime);
+    }
+    if (options.descending) {
+        std::reverse(entries.begin(), entries.end());
+    }
+    size_t first = std::min((options.page - 1) * PAGE_SIZE, entries.size());
+    size_t last = std::min(first + PAGE_SIZE, entries.size());
+    entries = std::vector<const DirectoryEntry *>(entries.begin() + first, entries.begin() + last);
+
+    if (listing->pages.size() >= MAX_PAGES) {
+        listing->pages.clear();
+    }
+    GeneratedPage &page = listing->pages[key];
+    if (options.json) {
+        renderJson(entries, page.content);
+    } else {
+        renderHtml(entries, uri, options, pageCount, page.content);
+    }
+    return (&page);
+}
@@ -0,0 +1,141 @@
+#include "BodySink.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <vector>
+
+BodySink::~BodySink() {}
+
+FileBodySink::FileBodySink() : path(""), tempPath(""), fd(-1), error(false) {}
+
+FileBodySink::FileBodySink(const FileBodySink &other) : path(""), tempPath(""), fd(-1), error(false) {
+    *this = other;
+}
+
+FileBodySink &FileBodySink::operator=(const FileBodySink &other) {
+    if (this != &other) {
+        abort();
+    }
+    return (*this);
+}
+
+FileBodySink::~FileBodySink() {
+    abort();
+}
+
+bool FileBodySink::open(const std::string &path) {
+    abort();
+
+    std::string pattern = path + ".XXXXXX";
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    fd = mkstemp(&name[0]);
+    if (fd == -1) {
+        return (false);
+    }
+
+    // mkstemp creates the file private, uploads get the usual permissions
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
+
+    this->path = path;
+    tempPath = &name[0];
+    error = false;
+    return (true);
+}
+
+void FileBodySink::write(const char *data, size_t size) {
+    while (fd != -1 && !error && size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = true;
+            return;
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+bool FileBodySink::failed() const {
+    return (error);
+}
+
+// Returns 0 once the file is in place, otherwise the errno that prevented it
+int FileBodySink::commit() {
+    if (fd == -1) {
+        return (EBADF);
+    }
+
+    int result = 0;
+    if (error || close(fd) == -1) {
+        result = EIO;
+    } else if (link(tempPath.c_str(), path.c_str()) == -1) {
+        // Linking never replaces a file created while the body was uploading
+        result = errno;
+    }
+    fd = -1;
+    unlink(tempPath.c_str());
+    tempPath.clear();
+    path.clear();
+    return (result);
+}
+
+void FileBodySink::abort() {
+    if (fd == -1) {
+        return;
+    }
+    close(fd);
+    unlink(tempPath.c_str());
+    fd = -1;
+    tempPath.clear();
+    path.clear();
+}
+
+bool FileBodySink::isOpen() const {
+    return (fd != -1);
+}
+
+QueueBodySink::QueueBodySink() : queue(NULL) {}
+
+QueueBodySink::QueueBodySink(const QueueBodySink &other) : queue(NULL) {
+    *this = other;
+}
+
+// The queue belongs to the owner of the original sink, so the copy is detached
+QueueBodySink &QueueBodySink::operator=(const QueueBodySink &other) {
+    if (this != &other) {
+        queue = NULL;
+    }
+    return (*this);
+}
+
+QueueBodySink::~QueueBodySink() {}
+
+void QueueBodySink::attach(OutputQueue *queue) {
+    this->queue = queue;
+}
+
+// Bytes written after the reader went away are dropped
+void QueueBodySink::detach() {
+    queue = NULL;
+}
+
+void QueueBodySink::write(const char *data, size_t size) {
+    if (queue == NULL) {
+        return;
+    }
+    std::string chunk(data, size);
+    queue->push(chunk);
+}
+
+bool QueueBodySink::failed() const {
+    return (false);
+}
@@ -1,24 +1,43 @@
 #include "Client.hpp"
 
 #include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
 #include <sys/stat.h>
-#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <cstdio>
 #include <cstring>
-#include <fstream>
 #include <sstream>
 
+#include "utils.h"
+
+extern char** environ;
+
+// posix_spawn_file_actions_addchdir_np came with glibc 2.29, elsewhere the server itself changes
+// directory around the spawn
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define HAS_SPAWN_CHDIR
+#endif
+
 const size_t Client::READ_BUFFER_SIZE = 1024 * 2;          // 2 KB
-const size_t Client::WRITE_BUFFER_SIZE = 1024 * 1024 * 1;  // 1 MB
 const long long Client::CGI_TIMEOUT_IN_MILLIS = 2000;      // 2 seconds
+const long long Client::HEADER_TIMEOUT_IN_MILLIS = 60000;  // 60 seconds
+const long long Client::BODY_TIMEOUT_IN_MILLIS = 60000;    // 60 seconds
+const long long Client::SEND_TIMEOUT_IN_MILLIS = 60000;    // 60 seconds
+const size_t Client::MAX_PIPELINE_DEPTH = 16;
+const size_t Client::MAX_BODY_BACKLOG = 1024 * 64;      // 64 KB
+const size_t Client::MAX_CGI_BACKLOG = 1024 * 256;      // 256 KB
+const size_t Client::MAX_CGI_HEADER_SIZE = 1024 * 8;  // 8 KB
 
-Client::Client() : fd(0), pipeIn(0), pipeOut(0), request(), response(), responseStr(""), cgiOutputStr(""), cgiInputStr(""), cgiPid(0), cgiStarProcessTimestamp(0), cgiConfig(), logger("CLIENT") {}
+std::map<std::string, std::string> Client::inheritedEnvironment;
 
-Client::Client(int fd) : fd(fd), pipeIn(0), pipeOut(0), request(), response(), responseStr(""), cgiOutputStr(""), cgiInputStr(""), cgiPid(0), cgiStarProcessTimestamp(0), cgiConfig(), logger("CLIENT") {}
+Client::Client() : fd(0), pipeIn(0), pipeOut(0), request(), response(), output(), cgiOutputStr(""), cgiState(CGI_HEADERS), cgiChunked(false), cgiOutputRead(false), cgiInput(), cgiPid(0), cgiStatus(0), processReaper(NULL), upstreamFd(0), upstreamAddress(""), upstreamReader(), fastCgiPool(NULL), cgiConfig(NULL), requestCount(0), keepAlive(true), pipelinedRequests(0), readPaused(false), keepaliveTimeout(ServerConfig::DEFAULT_KEEPALIVE_TIMEOUT * 1000), idleTimer(), cgiTimer(), requestServer(NULL), requestConfig(NULL), uploadSink(), cgiSink(), fastCgiSink(), bodySink(NULL), logger("CLIENT") {}
+
+Client::Client(int fd) : fd(fd), pipeIn(0), pipeOut(0), request(), response(), output(), cgiOutputStr(""), cgiState(CGI_HEADERS), cgiChunked(false), cgiOutputRead(false), cgiInput(), cgiPid(0), cgiStatus(0), processReaper(NULL), upstreamFd(0), upstreamAddress(""), upstreamReader(), fastCgiPool(NULL), cgiConfig(NULL), requestCount(0), keepAlive(true), pipelinedRequests(0), readPaused(false), keepaliveTimeout(ServerConfig::DEFAULT_KEEPALIVE_TIMEOUT * 1000), idleTimer(fd, TIMER_IDLE), cgiTimer(fd, TIMER_CGI), requestServer(NULL), requestConfig(NULL), uploadSink(), cgiSink(), fastCgiSink(), bodySink(NULL), logger("CLIENT") {}
 
 Client::~Client() {}
 
@@ -33,16 +52,74 @@ Client& Client::operator=(const Client& other) {
         this->pipeOut = other.pipeOut;
         this->request = other.request;
         this->response = other.response;
-        this->responseStr = other.responseStr;
+        this->output = other.output;
         this->cgiOutputStr = other.cgiOutputStr;
-        this->cgiInputStr = other.cgiInputStr;
+        this->cgiState = other.cgiState;
+        this->cgiChunked = other.cgiChunked;
+        this->cgiOutputRead = other.cgiOutputRead;
+        this->cgiInput = other.cgiInput;
         this->cgiPid = other.cgiPid;
+        this->cgiStatus = other.cgiStatus;
+        this->processReaper = other.processReaper;
+        this->upstreamFd = other.upstreamFd;
+        this->upstreamAddress = other.upstreamAddress;
+        this->upstreamReader = other.upstreamReader;
+        this->fastCgiPool = other.fastCgiPool;
         this->logger = other.logger;
         this->cgiConfig = other.cgiConfig;
+        this->requestCount = other.requestCount;
+        this->keepAlive = other.keepAlive;
+        this->pipelinedRequests = other.pipelinedRequests;
+        this->readPaused = other.readPaused;
+        this->keepaliveTimeout = other.keepaliveTimeout;
+        this->idleTimer = other.idleTimer;
+        this->cgiTimer = other.cgiTimer;
+        this->requestServer = other.requestServer;
+        this->requestConfig = other.requestConfig;
+        // Sinks are tied to the original connection, a copy buffers whatever body remains
+        this->uploadSink = other.uploadSink;
+        this->cgiSink = other.cgiSink;
+        this->fastCgiSink = other.fastCgiSink;
+        this->bodySink = NULL;
     }
     return *this;
 }
 
+void Client::reset(int fd) {
+    this->fd = fd;
+    pipeIn = 0;
+    pipeOut = 0;
+    request = HttpRequest();
+    response = HttpResponse();
+    output.clear();
+    std::string().swap(cgiOutputStr);
+    cgiState = CGI_HEADERS;
+    cgiChunked = false;
+    cgiOutputRead = false;
+    cgiInput.clear();
+    cgiPid = 0;
+    cgiStatus = 0;
+    processReaper = NULL;
+    upstreamFd = 0;
+    upstreamAddress.clear();
+    upstreamReader.reset();
+    fastCgiPool = NULL;
+    cgiConfig = NULL;
+    requestCount = 0;
+    keepAlive = true;
+    pipelinedRequests = 0;
+    readPaused = false;
+    keepaliveTimeout = ServerConfig::DEFAULT_KEEPALIVE_TIMEOUT * 1000;
+    idleTimer = Timer(fd, TIMER_IDLE);
+    cgiTimer = Timer(fd, TIMER_CGI);
+    requestServer = NULL;
+    requestConfig = NULL;
+    uploadSink.abort();
+    cgiSink.detach();
+    fastCgiSink.detach();
+    bodySink = NULL;
+}
+
 int Client::getFd() const {
     return this->fd;
 }
@@ -51,14 +128,25 @@ int Client::getPipeOut() const {
     return this->pipeOut;
 }
 
-bool Client::isFdValid(int fd) const {
-    return (fd == this->fd || fd == pipeIn || fd == pipeOut);
+void Client::setKeepaliveTimeout(size_t seconds) {
+    if (seconds > 0) {
+        keepaliveTimeout = seconds * 1000;
+    }
+}
+
+void Client::setFastCgiPool(FastCgiPool* pool) {
+    fastCgiPool = pool;
 }
 
-static long long getCurrentTimeMillis() {
-    struct timeval time;
-    gettimeofday(&time, NULL);
-    return (time.tv_sec * 1000LL) + (time.tv_usec / 1000);
+void Client::setProcessReaper(ProcessReaper* reaper) {
+    processReaper = reaper;
+}
+
+static void closePipe(int pipeFds[2]) {
+    if (pipeFds[0] != -1) {
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+    }
 }
 
 static int setNonBlockingFlag(int fd) {
@@ -69,289 +157,758 @@ static int setNonBlockingFlag(int fd) {
     return (fcntl(fd, F_SETFL, flags | O_NONBLOCK));
 }
 
-std::string Client::createCgiProcess(const Configurations& config, std::string& execPath, std::string& scriptPath, std::vector<pollfd>& fdsToAdd) {
+static int setCloseOnExecFlag(int fd) {
+    int flags = fcntl(fd, F_GETFD, 0);
+    if (flags == -1) {
+        return (-1);
+    }
+    return (fcntl(fd, F_SETFD, flags | FD_CLOEXEC));
+}
+
+// Both ends are closed on exec, so a script never holds another script's pipe open. Only the
+// server's end is non-blocking, the script's end blocks so a slow reader or writer throttles it
+static bool openCgiPipe(int pipeFds[2], int serverEnd) {
+    if (pipe(pipeFds) == -1) {
+        return (false);
+    }
+    if (setCloseOnExecFlag(pipeFds[0]) == -1 || setCloseOnExecFlag(pipeFds[1]) == -1 || setNonBlockingFlag(pipeFds[serverEnd]) == -1) {
+        closePipe(pipeFds);
+        pipeFds[0] = pipeFds[1] = -1;
+        return (false);
+    }
+    return (true);
+}
+
+// Variables handed to a script, as its environment or as the params of a FastCGI request
+void Client::createCgiEnvironment(const std::string& scriptPath, std::map<std::string, std::string>& environment) const {
+    environment["REQUEST_METHOD"] = getMethodString(request.getMethod());
+    environment["REQUEST_URI"] = request.getUri();
+    environment["SERVER_PROTOCOL"] = request.getVersion();
+    environment["SERVER_SOFTWARE"] = "webserv";
+    std::string cookies;
+    for (std::map<std::string, std::string>::const_iterator it = request.getCookies().begin(); it != request.getCookies().end(); ++it) {
+        cookies += it->first + "=" + it->second + "; ";
+    }
+    if (!cookies.empty()) {
+        environment["HTTP_COOKIE"] = cookies;
+    }
+    environment["SCRIPT_NAME"] = scriptPath;
+    environment["QUERY_STRING"] = request.getQueryParameters();
+    // A chunked body is streamed as it is decoded, so its length is unknown and the script reads until EOF
+    if (!request.isChunked()) {
+        environment["CONTENT_LENGTH"] = numberToString(request.getContentLength());
+    }
+    environment["GATEWAY_INTERFACE"] = "CGI/1.1";
+
+    for (size_t i = 0; i < request.getHeaderCount(); ++i) {
+        environment["HTTP_" + request.getHeaderName(i)] = request.getHeaderValue(i);
+    }
+}
+
+void Client::createCgiProcess(const Configurations& config, std::string& execPath, std::string& scriptPath, EventLoop& eventLoop, FdRegistry& registry) {
     if (access(scriptPath.c_str(), F_OK) == -1) {
-        return (response.createErrorResponse(404, config.getRoot(), config.getErrorPages()));
+        response.createErrorResponse(output, 404, config.getErrorPages());
+        return;
     }
 
     int pipeInput[2], pipeOutput[2];
     pipeInput[0] = pipeInput[1] = -1;
+    pipeOutput[0] = pipeOutput[1] = -1;
 
-    if (pipe(pipeOutput) == -1) {
-        return (response.createErrorResponse(500, config.getRoot(), config.getErrorPages()));
+    bool hasBody = request.getContentLength() > 0 || request.isChunked();
+    pid_t pid = -1;
+    if (openCgiPipe(pipeOutput, 0) && (!hasBody || openCgiPipe(pipeInput, 1))) {
+        pid = spawnCgiProcess(execPath, scriptPath, pipeInput, pipeOutput);
     }
 
-    if (setNonBlockingFlag(pipeOutput[0]) == -1 || setNonBlockingFlag(pipeOutput[1]) == -1) {
-        close(pipeOutput[0]);
-        close(pipeOutput[1]);
-        return (response.createErrorResponse(500, config.getRoot(), config.getErrorPages()));
+    if (pid == -1) {
+        closePipe(pipeInput);
+        closePipe(pipeOutput);
+        response.createErrorResponse(output, 500, config.getErrorPages());
+        return;
     }
 
-    if (!request.getBody().empty() && pipe(pipeInput) == -1) {
-        close(pipeOutput[0]);
-        close(pipeOutput[1]);
-        return (response.createErrorResponse(500, config.getRoot(), config.getErrorPages()));
+    cgiPid = pid;
+    cgiStatus = 0;
+    if (processReaper != NULL) {
+        processReaper->watch(pid, this);
     }
-
-    if (pipeInput[0] != -1 && (setNonBlockingFlag(pipeInput[0]) == -1 || setNonBlockingFlag(pipeInput[1]) == -1)) {
-        close(pipeOutput[0]);
-        close(pipeOutput[1]);
+    cgiConfig = &config;
+    cgiState = CGI_HEADERS;
+    cgiChunked = false;
+    cgiOutputRead = false;
+    if (pipeInput[0] != -1) {
         close(pipeInput[0]);
-        close(pipeInput[1]);
-        return (response.createErrorResponse(500, config.getRoot(), config.getErrorPages()));
+        pipeIn = pipeInput[1];
+        registry.add(pipeIn, FD_CGI_INPUT, registry.get(fd).server, this);
+        eventLoop.watch(pipeIn, 0);
     }
 
-    cgiStarProcessTimestamp = getCurrentTimeMillis();
-    int pid = fork();
-    if (pid == -1) {
-        close(pipeOutput[0]);
-        close(pipeOutput[1]);
-        if (pipeInput[0] != -1) {
-            close(pipeInput[0]);
-            close(pipeInput[1]);
+    close(pipeOutput[1]);
+    pipeOut = pipeOutput[0];
+    registry.add(pipeOut, FD_CGI_OUTPUT, registry.get(fd).server, this);
+    eventLoop.watch(pipeOut, POLLIN);
+}
+
+// The server's environment never changes, it is read once before the workers start
+void Client::loadInheritedEnvironment() {
+    inheritedEnvironment.clear();
+    for (char** variable = environ; *variable != NULL; ++variable) {
+        std::string entry(*variable);
+        size_t equal = entry.find('=');
+        if (equal != std::string::npos) {
+            inheritedEnvironment[entry.substr(0, equal)] = entry;
         }
-        return (response.createErrorResponse(500, config.getRoot(), config.getErrorPages()));
     }
+}
 
-    if (pid == 0) {
-        if (pipeInput[0] != -1) {
-            close(pipeInput[1]);
-            dup2(pipeInput[0], STDIN_FILENO);
-            close(pipeInput[0]);
+// posix_spawn shares the server's address space until the exec instead of copying its page tables,
+// so launching a script costs the same however large the server has grown
+pid_t Client::spawnCgiProcess(const std::string& execPath, const std::string& scriptPath, int pipeInput[2], int pipeOutput[2]) {
+    std::map<std::string, std::string> environment;
+    createCgiEnvironment(scriptPath, environment);
+
+    std::vector<std::string> entries;
+    entries.reserve(environment.size());
+    for (std::map<std::string, std::string>::const_iterator it = environment.begin(); it != environment.end(); ++it) {
+        entries.push_back(it->first + "=" + it->second);
+    }
+    // The script sees the server's environment with the request variables on top, the inherited
+    // entries are passed as they are stored
+    std::vector<char*> envp;
+    envp.reserve(inheritedEnvironment.size() + entries.size() + 1);
+    for (std::map<std::string, std::string>::const_iterator it = inheritedEnvironment.begin(); it != inheritedEnvironment.end(); ++it) {
+        if (environment.find(it->first) == environment.end()) {
+            envp.push_back(const_cast<char*>(it->second.c_str()));
         }
+    }
+    for (std::vector<std::string>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        envp.push_back(&(*it)[0]);
+    }
+    envp.push_back(NULL);
+
+    std::string dir = scriptPath.substr(0, scriptPath.find_last_of('/'));
+    std::string scriptFile = scriptPath.substr(scriptPath.find_last_of('/') + 1);
+    char* argv[] = {(char*)execPath.c_str(), (char*)scriptFile.c_str(), NULL};
+
+    // The duplicates on stdin and stdout lose the close-on-exec flag, they are all the script keeps
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    // A script without a body reads an empty stdin rather than the server's
+    if (pipeInput[0] != -1) {
+        posix_spawn_file_actions_adddup2(&actions, pipeInput[0], STDIN_FILENO);
+    } else {
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    }
+    posix_spawn_file_actions_adddup2(&actions, pipeOutput[1], STDOUT_FILENO);
+#ifdef HAS_SPAWN_CHDIR
+    posix_spawn_file_actions_addchdir_np(&actions, dir.c_str());
+#endif
+
+    // An ignored signal stays ignored across the exec, the script gets back the default SIGPIPE the
+    // server gave up, so writing to a closed pipe ends it instead of failing silently
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &defaults);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid;
+#ifdef HAS_SPAWN_CHDIR
+    int error = posix_spawn(&pid, execPath.c_str(), &actions, &attributes, argv, &envp[0]);
+#else
+    // A worker runs a single thread, nothing else sees the directory change before it is undone
+    int error = 0;
+    int serverDir = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (serverDir == -1 || chdir(dir.c_str()) == -1) {
+        error = errno;
+    } else {
+        error = posix_spawn(&pid, execPath.c_str(), &actions, &attributes, argv, &envp[0]);
+        if (fchdir(serverDir) == -1) {
+            logger.error() << "fchdir: " << std::strerror(errno) << std::endl;
+        }
+    }
+    if (serverDir != -1) {
+        close(serverDir);
+    }
+#endif
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    if (error != 0) {
+        logger.error() << "posix_spawn: " << std::strerror(error) << std::endl;
+        return (-1);
+    }
+    return (pid);
+}
 
-        close(pipeOutput[0]);
-        dup2(pipeOutput[1], STDOUT_FILENO);
-        close(pipeOutput[1]);
+// The request goes to a long-lived application over a pooled connection instead of a new process
+void Client::startFastCgi(const Configurations& config, const std::string& scriptPath, EventLoop& eventLoop, FdRegistry& registry) {
+    upstreamAddress = config.getFastCgiPass();
+    int connection = (fastCgiPool != NULL) ? fastCgiPool->acquire(upstreamAddress) : -1;
+    if (connection == -1) {
+        response.createErrorResponse(output, 502, config.getErrorPages());
+        return;
+    }
 
-        std::string dir = scriptPath.substr(0, scriptPath.find_last_of('/'));
-        if (chdir(dir.c_str()) == -1) {
-            exit(1);
-        }
+    upstreamFd = connection;
+    upstreamReader.reset();
+    cgiConfig = &config;
+    cgiState = CGI_HEADERS;
+    cgiChunked = false;
+    cgiOutputRead = false;
+
+    std::map<std::string, std::string> params;
+    createCgiEnvironment(scriptPath, params);
+    params["SCRIPT_FILENAME"] = scriptPath;
+    FastCgiRecord::pushBeginRequest(cgiInput);
+    FastCgiRecord::pushParams(cgiInput, params);
+    // A request with a body ends its stdin once the body sink is done with it
+    if (request.getContentLength() == 0 && !request.isChunked()) {
+        FastCgiRecord::pushStream(cgiInput, FCGI_STDIN, NULL, 0);
+    }
 
-        setenv("REQUEST_METHOD", getMethodString(request.getMethod()).c_str(), 1);
-        setenv("REQUEST_URI", request.getUri().c_str(), 1);
-        setenv("SERVER_PROTOCOL", request.getVersion().c_str(), 1);
-        setenv("SERVER_SOFTWARE", "webserv", 1);
-        std::string cookies;
-        for (std::map<std::string, std::string>::const_iterator it = request.getCookies().begin(); it != request.getCookies().end(); ++it) {
-            cookies += it->first + "=" + it->second + "; ";
-        }
-        if (!cookies.empty()) {
-            setenv("HTTP_COOKIE", cookies.c_str(), 1);
-        }
-        setenv("SCRIPT_NAME", scriptPath.c_str(), 1);
-        setenv("QUERY_STRING", request.getQueryParameters().c_str(), 1);
-        setenv("CONTENT_LENGTH", numberToString(request.getBody().size()).c_str(), 1);
-        setenv("GATEWAY_INTERFACE", "CGI/1.1", 1);
+    registry.add(upstreamFd, FD_FASTCGI, registry.get(fd).server, this);
+    eventLoop.watch(upstreamFd, POLLIN | POLLOUT);
+}
 
-        for (std::map<std::string, std::string>::const_iterator it = request.getHeaders().begin(); it != request.getHeaders().end(); ++it) {
-            setenv(("HTTP_" + it->first).c_str(), it->second.c_str(), 1);
-        }
+bool Client::hasPendingOutput() const {
+    return (!output.empty());
+}
 
-        std::string scriptFile = scriptPath.substr(scriptPath.find_last_of('/') + 1);
-        char* argv[] = {(char*)execPath.c_str(), (char*)scriptFile.c_str(), NULL};
-        execv(execPath.c_str(), argv);
+// A connection that won't be kept and has nothing left to send or receive
+bool Client::isFinished() const {
+    return (!keepAlive && output.empty() && !isCgiRunning() && pipeOut == 0 && !request.isReadingBody());
+}
 
-        exit(1);
-    } else {
-        cgiPid = pid;
-        cgiConfig = config;
-        cgiInputStr = request.getBody();
-        if (pipeInput[0] != -1) {
-            close(pipeInput[0]);
-            pipeIn = pipeInput[1];
+// A script that exited may still have output left in its pipe
+bool Client::isCgiRunning() const {
+    return (cgiPid != 0 || pipeOut != 0 || upstreamFd != 0);
+}
 
-            struct pollfd pfdIn;
-            pfdIn.fd = pipeIn;
-            pfdIn.events = POLLOUT;
-            pfdIn.revents = 0;
-            fdsToAdd.push_back(pfdIn);
-        }
+// Stops a script whose output is no longer wanted, the reaper collects it once it exits
+void Client::terminateCgiProcess() {
+    if (cgiPid != 0 && processReaper != NULL) {
+        processReaper->terminate(cgiPid);
+    }
+    cgiPid = 0;
+}
 
-        close(pipeOutput[1]);
-        pipeOut = pipeOutput[0];
+// Stops reading while requests can't be dispatched, so the socket buffer applies backpressure
+void Client::updateEvents(EventLoop& eventLoop) const {
+    short events = isPipelineBlocked() ? 0 : POLLIN;
+    // A finished connection is closed by the next flush, even one with nothing to write
+    if (hasPendingOutput() || isFinished()) {
+        events |= POLLOUT;
+    }
+    eventLoop.watch(fd, events);
+    if (pipeIn != 0) {
+        eventLoop.watch(pipeIn, cgiInput.empty() ? 0 : POLLOUT);
+    }
+    // Unwatched rather than masked, poll would keep reporting the hang up of a pipe left unread
+    if (pipeOut != 0) {
+        if (isCgiOutputPaused()) {
+            eventLoop.unwatch(pipeOut);
+        } else {
+            eventLoop.watch(pipeOut, POLLIN);
+        }
+    }
+    if (upstreamFd != 0) {
+        short upstreamEvents = isCgiOutputPaused() ? 0 : POLLIN;
+        if (!cgiInput.empty()) {
+            upstreamEvents |= POLLOUT;
+        }
+        if (upstreamEvents == 0) {
+            eventLoop.unwatch(upstreamFd);
+        } else {
+            eventLoop.watch(upstreamFd, upstreamEvents);
+        }
+    }
+}
 
-        struct pollfd pfdOut;
-        pfdOut.fd = pipeOut;
-        pfdOut.events = POLLIN;
-        pfdOut.revents = 0;
-        fdsToAdd.push_back(pfdOut);
+// Re-arms the deadline that matches what the connection is waiting for
+void Client::updateTimers(TimerWheel& timers) {
+    // A script still receiving its body is bounded by the body timeout, one waiting on a slow
+    // client by the send timeout. Otherwise any output restarts the CGI timeout, which bounds its silence
+    if (isCgiRunning() && !request.isReadingBody() && !isCgiOutputPaused()) {
+        idleTimer.cancel();
+        if (cgiOutputRead || !cgiTimer.isScheduled()) {
+            timers.schedule(cgiTimer, CGI_TIMEOUT_IN_MILLIS);
+        }
+        cgiOutputRead = false;
+        return;
+    }
 
-        return ("");
+    cgiTimer.cancel();
+    if (hasPendingOutput()) {
+        timers.schedule(idleTimer, SEND_TIMEOUT_IN_MILLIS);
+    } else if (request.isEmpty()) {
+        timers.schedule(idleTimer, keepaliveTimeout);
+    } else if (request.hasHeaders()) {
+        timers.schedule(idleTimer, BODY_TIMEOUT_IN_MILLIS);
+    } else {
+        timers.schedule(idleTimer, HEADER_TIMEOUT_IN_MILLIS);
     }
 }
 
-void Client::closeAll() const {
+void Client::closeAll(EventLoop& eventLoop, FdRegistry& registry) {
+    output.clear();
+    cgiInput.clear();
+    cgiSink.detach();
+    fastCgiSink.detach();
+    uploadSink.abort();
+    terminateCgiProcess();
+    if (upstreamFd != 0) {
+        closeUpstream(eventLoop, registry);
+    }
     if (pipeIn != 0) {
+        registry.remove(pipeIn);
+        eventLoop.unwatch(pipeIn);
         close(pipeIn);
     }
     if (pipeOut != 0) {
+        registry.remove(pipeOut);
+        eventLoop.unwatch(pipeOut);
         close(pipeOut);
     }
 }
 
-int Client::processSendedData(int fdAffected, const std::vector<Server>& servers, std::vector<pollfd>& fdsToAdd) {
+void Client::processHandUp(int fdAffected) {
+    if (fdAffected == upstreamFd) {
+        failUpstream();
+    } else if (fdAffected == pipeOut) {
+        readCgiResponse();
+    } else if (fdAffected == pipeIn) {
+        pipeIn = 0;
+        cgiInput.clear();
+        cgiSink.detach();
+    }
+}
+
+int Client::processSendedData(int fdAffected, const std::vector<Server>& servers, EventLoop& eventLoop, FdRegistry& registry) {
+    if (fdAffected == upstreamFd) {
+        return (processUpstream(eventLoop, registry));
+    }
+    if (fdAffected != fd) {
+        return (readCgiOutput(fdAffected));
+    }
+
     char buffer[READ_BUFFER_SIZE];
-    ssize_t bytesRead = 0;
+    ssize_t bytesRead = READ_BUFFER_SIZE;
 
-    bytesRead = read(fdAffected, buffer, READ_BUFFER_SIZE);
-    if (bytesRead == -1) {
-        logger.perror("read");
-        if (fdAffected != fd) {
-            pipeOut = 0;
+    // Stops on a short read, which is what edge-triggered backends need to see the fd drained
+    while (bytesRead == static_cast<ssize_t>(READ_BUFFER_SIZE)) {
+        if (isPipelineBlocked()) {
+            readPaused = true;
+            return (0);
+        }
+
+        bytesRead = read(fd, buffer, READ_BUFFER_SIZE);
+        if (bytesRead == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return (0);
+            }
+            logger.perror("read");
+            return (fd);
+        }
+
+        if (bytesRead == 0) {
+            return (fd);
         }
-        return (fdAffected);
+
+        if (!request.digestRequest(std::string(buffer, bytesRead))) {
+            const Configurations& config = servers.begin()->getConfig();
+            keepAlive = false;
+            response.setConnection(false, 0, 0);
+            response.createErrorResponse(output, 400, config.getErrorPages());
+            return (0);
+        }
+
+        dispatchRequests(servers, eventLoop, registry);
+    }
+
+    if (isPipelineBlocked()) {
+        readPaused = true;
     }
+    return (0);
+}
 
-    if (bytesRead == 0) {
-        if (fdAffected != fd) {
+// Reads until the pipe is empty rather than until a short read, a pipe can hang up with data
+// still in it and edge-triggered backends won't report it twice. Stops early once the client
+// has too much left to send, the pipe is watched again when the socket drains
+int Client::readCgiOutput(int pipeFd) {
+    char buffer[READ_BUFFER_SIZE];
+
+    while (!isCgiOutputPaused()) {
+        ssize_t bytesRead = read(pipeFd, buffer, READ_BUFFER_SIZE);
+        if (bytesRead == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return (0);
+            }
+            logger.perror("read");
+        }
+
+        if (bytesRead <= 0) {
             pipeOut = 0;
             readCgiResponse();
+            return (pipeFd);
         }
-        return (fdAffected);
+
+        cgiOutputRead = true;
+        relayCgiOutput(buffer, bytesRead);
     }
+    return (0);
+}
 
-    if (fdAffected != fd) {
-        cgiOutputStr += std::string(buffer, bytesRead);
-        return (0);
+bool Client::isCgiOutputPaused() const {
+    return ((pipeOut != 0 || upstreamFd != 0) && output.size() >= MAX_CGI_BACKLOG);
+}
+
+// Writes the queued records and reads the answer in one pass, edge-triggered backends may
+// report both directions in a single event
+int Client::processUpstream(EventLoop& eventLoop, FdRegistry& registry) {
+    if (!cgiInput.empty() && cgiInput.flush(upstreamFd) == OutputQueue::OUTPUT_ERROR) {
+        logger.perror("write");
+        return (failUpstream());
     }
 
-    if (!request.digestRequest(std::string(buffer, bytesRead))) {
-        Configurations config = servers.begin()->getConfig();
-        responseStr = response.createErrorResponse(400, config.getRoot(), config.getErrorPages());
-        return (0);
+    char buffer[READ_BUFFER_SIZE];
+    while (!isCgiOutputPaused()) {
+        ssize_t bytesRead = read(upstreamFd, buffer, READ_BUFFER_SIZE);
+        if (bytesRead == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return (0);
+            }
+            logger.perror("read");
+        }
+        if (bytesRead <= 0) {
+            return (failUpstream());
+        }
+
+        cgiOutputRead = true;
+        std::string content;
+        if (!upstreamReader.read(buffer, bytesRead, content)) {
+            logger.error() << "Malformed FastCGI record from " << upstreamAddress << std::endl;
+            return (failUpstream());
+        }
+        relayCgiOutput(content.data(), content.size());
+        if (upstreamReader.isEnded()) {
+            releaseUpstream(eventLoop, registry);
+            return (0);
+        }
     }
+    return (0);
+}
 
-    if (request.isComplete()) {
-        matchUriAndResponseClient(servers, fdsToAdd);
+// The connection is closed by the caller, a response not started yet becomes a 502
+int Client::failUpstream() {
+    int connection = upstreamFd;
+    upstreamFd = 0;
+    upstreamReader.reset();
+    cgiInput.clear();
+    fastCgiSink.detach();
+    finishCgiResponse(true, 502);
+    return (connection);
+}
+
+// Stdin still unsent or a request the application gave up on leaves the connection out of step, so it is closed
+void Client::releaseUpstream(EventLoop& eventLoop, FdRegistry& registry) {
+    bool failed = upstreamReader.hasFailed();
+    registry.remove(upstreamFd);
+    eventLoop.unwatch(upstreamFd);
+    if (fastCgiPool != NULL && upstreamReader.isReusable() && cgiInput.empty() && !request.isReadingBody()) {
+        fastCgiPool->release(upstreamAddress, upstreamFd);
+    } else {
+        close(upstreamFd);
     }
+    upstreamFd = 0;
+    upstreamReader.reset();
+    cgiInput.clear();
+    fastCgiSink.detach();
+    finishCgiResponse(failed, 502);
+}
 
-    return (0);
+void Client::closeUpstream(EventLoop& eventLoop, FdRegistry& registry) {
+    registry.remove(upstreamFd);
+    eventLoop.unwatch(upstreamFd);
+    close(upstreamFd);
+    upstreamFd = 0;
+    upstreamReader.reset();
 }
 
-void Client::readCgiResponse() {
-    int status;
-    waitpid(cgiPid, &status, 0);
-    cgiPid = 0;
+// Responses are queued in request order, so a CGI in flight holds back the requests behind it.
+// A body being read keeps flowing until the CGI falls too far behind on it
+bool Client::isPipelineBlocked() const {
+    if (request.isReadingBody()) {
+        return (cgiInput.size() >= MAX_BODY_BACKLOG);
+    }
+    return (!keepAlive || isCgiRunning() || pipelinedRequests >= MAX_PIPELINE_DEPTH);
+}
 
-    if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
-        responseStr = response.createErrorResponse(500, cgiConfig.getRoot(), cgiConfig.getErrorPages());
-        cgiOutputStr.clear();
+void Client::dispatchRequests(const std::vector<Server>& servers, EventLoop& eventLoop, FdRegistry& registry) {
+    while (true) {
+        // The application only answers after the end of its stdin, which can't wait for the blocked pipeline
+        if (bodySink == &fastCgiSink && request.isComplete()) {
+            fastCgiSink.finish();
+        }
+        if (isPipelineBlocked()) {
+            return;
+        }
+
+        if (request.isAwaitingBody()) {
+            matchUri(servers);
+            routeBody(eventLoop, registry);
+        } else if (isBodyTooLarge()) {
+            rejectBody(eventLoop, registry);
+            return;
+        } else if (request.isComplete()) {
+            if (requestConfig == NULL) {
+                matchUri(servers);
+            }
+            responseClient(eventLoop, registry);
+            pipelinedRequests++;
+        } else {
+            return;
+        }
+
+        // Streams the body just routed, or parses the next request already buffered
+        if (!request.digestRequest("")) {
+            const Configurations& config = servers.begin()->getConfig();
+            keepAlive = false;
+            response.setConnection(false, 0, 0);
+            response.createErrorResponse(output, 400, config.getErrorPages());
+            return;
+        }
+    }
+}
+
+int Client::resumeRequests(const std::vector<Server>& servers, EventLoop& eventLoop, FdRegistry& registry) {
+    if (!readPaused || isPipelineBlocked()) {
+        return (0);
+    }
+    readPaused = false;
+    dispatchRequests(servers, eventLoop, registry);
+    return (processSendedData(fd, servers, eventLoop, registry));
+}
+
+// The header block ends at the first empty line, scripts may end their lines with LF or CRLF
+static size_t findCgiBodyStart(const std::string& cgiOutput) {
+    size_t pos = 0;
+    while (pos < cgiOutput.size()) {
+        if (cgiOutput[pos] == '\n') {
+            return (pos + 1);
+        }
+        if (cgiOutput.compare(pos, 2, "\r\n") == 0) {
+            return (pos + 2);
+        }
+        pos = cgiOutput.find('\n', pos);
+        if (pos == std::string::npos) {
+            break;
+        }
+        pos++;
+    }
+    return (std::string::npos);
+}
+
+void Client::relayCgiOutput(const char* data, size_t size) {
+    if (cgiState == CGI_DISCARD || size == 0) {
+        return;
+    }
+    if (cgiState == CGI_BODY) {
+        pushCgiBody(data, size);
+        return;
+    }
+
+    cgiOutputStr.append(data, size);
+    size_t bodyStart = findCgiBodyStart(cgiOutputStr);
+    if (bodyStart == std::string::npos) {
+        if (cgiOutputStr.size() > MAX_CGI_HEADER_SIZE) {
+            response.createErrorResponse(output, 500, cgiConfig->getErrorPages());
+            cgiState = CGI_DISCARD;
+            cgiOutputStr.clear();
+        }
         return;
     }
 
+    std::string body = cgiOutputStr.substr(bodyStart);
+    cgiOutputStr.erase(bodyStart);
+    if (!sendCgiHeaders(cgiOutputStr)) {
+        cgiState = CGI_DISCARD;
+    } else {
+        cgiState = CGI_BODY;
+        pushCgiBody(body.data(), body.size());
+    }
+    cgiOutputStr.clear();
+}
+
+// Answers 500 itself when the script's headers are unusable
+bool Client::sendCgiHeaders(const std::string& headerBlock) {
     std::map<std::string, std::string> responseHeaders;
-    std::istringstream responseStream(cgiOutputStr);
+    std::istringstream responseStream(headerBlock);
     std::string line;
     std::vector<std::string> cookies;
-    while (std::getline(responseStream, line) && line != "\r" && line != "") {
+    bool findContentType = false;
+    bool hasContentLength = false;
+    while (std::getline(responseStream, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        if (line.empty()) {
+            break;
+        }
         size_t pos = line.find(": ");
         if (pos == std::string::npos) {
-            responseStr = response.createErrorResponse(500, cgiConfig.getRoot(), cgiConfig.getErrorPages());
-            return;
+            response.createErrorResponse(output, 500, cgiConfig->getErrorPages());
+            return (false);
         }
         std::string key = line.substr(0, pos);
         if (HttpRequest::verifyHeaderKey(key)) {
-            responseStr = response.createErrorResponse(500, cgiConfig.getRoot(), cgiConfig.getErrorPages());
-            return;
+            response.createErrorResponse(output, 500, cgiConfig->getErrorPages());
+            return (false);
         }
         std::string value = line.substr(pos + 2);
         trim(value);
         if (HttpRequest::verifyHeaderValue(value)) {
-            responseStr = response.createErrorResponse(500, cgiConfig.getRoot(), cgiConfig.getErrorPages());
-            return;
+            response.createErrorResponse(output, 500, cgiConfig->getErrorPages());
+            return (false);
         }
         std::string headerKey = key;
         lowercase(headerKey);
         if (headerKey == "set-cookie") {
             cookies.push_back(value);
-        } else {
-            responseHeaders[key] = value;
+            continue;
         }
-    }
-
-    bool findContentType = false;
-    for (std::map<std::string, std::string>::const_iterator it = responseHeaders.begin(); it != responseHeaders.end(); ++it) {
-        std::string headerKey = it->first;
-        lowercase(headerKey);
         if (headerKey == "content-type") {
             findContentType = true;
-            break;
+        } else if (headerKey == "content-length") {
+            hasContentLength = true;
         }
+        responseHeaders[key] = value;
     }
+
     if (!findContentType) {
-        responseStr = response.createErrorResponse(500, cgiConfig.getRoot(), cgiConfig.getErrorPages());
-        return;
+        response.createErrorResponse(output, 500, cgiConfig->getErrorPages());
+        return (false);
     }
 
-    std::string body;
-    while (std::getline(responseStream, line)) {
-        body += line + "\n";
+    // Without a length from the script the body is framed in chunks
+    cgiChunked = !hasContentLength;
+    response.createStreamResponse(output, 200, responseHeaders, cookies, cgiChunked);
+    return (true);
+}
+
+void Client::pushCgiBody(const char* data, size_t size) {
+    std::string body(data, size);
+    if (cgiChunked) {
+        HttpResponse::pushChunk(output, body);
+    } else {
+        output.push(body);
+    }
+}
+
+// Called once the script closed its output, the response ends when its exit status is known too
+void Client::readCgiResponse() {
+    pipeOut = 0;
+    if (cgiPid == 0) {
+        finishCgiProcess();
+    }
+}
+
+// Called by the reaper, a script can exit before its output is fully read
+void Client::processCgiExit(int status) {
+    cgiPid = 0;
+    cgiStatus = status;
+    if (pipeOut == 0) {
+        finishCgiProcess();
     }
+}
+
+void Client::finishCgiProcess() {
+    finishCgiResponse(!WIFEXITED(cgiStatus) || WEXITSTATUS(cgiStatus) != 0, 500);
+}
 
+void Client::finishCgiResponse(bool failed, size_t errorStatus) {
+    if (cgiState == CGI_HEADERS) {
+        // Output that never reached an empty line is all headers and no body
+        if (failed) {
+            response.createErrorResponse(output, errorStatus, cgiConfig->getErrorPages());
+        } else if (sendCgiHeaders(cgiOutputStr) && cgiChunked) {
+            HttpResponse::pushLastChunk(output);
+        }
+    } else if (cgiState == CGI_BODY) {
+        // The status line is already out, a truncated body is the only way left to report the failure
+        if (failed) {
+            keepAlive = false;
+        } else if (cgiChunked) {
+            HttpResponse::pushLastChunk(output);
+        }
+    }
     cgiOutputStr.clear();
-    responseStr = response.createCgiResponse(200, body, responseHeaders, cookies);
+    cgiState = CGI_HEADERS;
 }
 
-void Client::verifyCgiTimeout(std::vector<int>& fdsToRemove) {
-    if (cgiPid == 0) {
+void Client::processCgiTimeout(std::vector<int>& fdsToRemove) {
+    if (!isCgiRunning()) {
         return;
     }
 
-    long long currentTimestamp = getCurrentTimeMillis();
-    if (currentTimestamp - cgiStarProcessTimestamp > CGI_TIMEOUT_IN_MILLIS) {
-        kill(cgiPid, SIGKILL);
-        cgiPid = 0;
-        cgiOutputStr.clear();
-        cgiInputStr.clear();
+    size_t status = 408;
+    terminateCgiProcess();
+    if (upstreamFd != 0) {
+        status = 504;
+        fdsToRemove.push_back(upstreamFd);
+        upstreamFd = 0;
+        upstreamReader.reset();
+    }
+    cgiOutputStr.clear();
+    cgiInput.clear();
+    cgiSink.detach();
+    fastCgiSink.detach();
+    if (pipeOut != 0) {
         fdsToRemove.push_back(pipeOut);
+    }
+    if (pipeIn != 0) {
         fdsToRemove.push_back(pipeIn);
-        pipeOut = 0;
-        pipeIn = 0;
-        responseStr = response.createErrorResponse(408, cgiConfig.getRoot(), cgiConfig.getErrorPages());
     }
+    pipeOut = 0;
+    pipeIn = 0;
+    if (cgiState == CGI_HEADERS) {
+        response.createErrorResponse(output, status, cgiConfig->getErrorPages());
+    } else {
+        keepAlive = false;
+    }
+    cgiState = CGI_HEADERS;
 }
 
 int Client::sendResponse(int clientSocket) {
-    if (clientSocket == fd && responseStr.size() == 0) {
+    OutputQueue& queue = (clientSocket == fd) ? output : cgiInput;
+
+    OutputQueue::Status status = queue.flush(clientSocket);
+    if (status == OutputQueue::OUTPUT_PENDING) {
         return (0);
-    } else if (clientSocket != fd && cgiInputStr.size() == 0) {
-        pipeIn = 0;
-        return (clientSocket);
     }
-
-    std::string buffer = (clientSocket == fd) ? responseStr : cgiInputStr;
-    ssize_t bytesToSend = std::min(buffer.size(), WRITE_BUFFER_SIZE);
-    std::string data = buffer.substr(0, bytesToSend);
-
-    ssize_t bytesSend = write(clientSocket, data.c_str(), data.size());
-    if (bytesSend == -1) {
-        if (clientSocket != fd) {
-            pipeIn = 0;
-        }
+    if (status == OutputQueue::OUTPUT_ERROR) {
         logger.perror("write");
-        return (clientSocket);
-    }
-    if (bytesSend != bytesToSend) {
+        queue.clear();
         if (clientSocket != fd) {
             pipeIn = 0;
+            cgiSink.detach();
         }
-        logger.error() << "Error: failed to send response" << std::endl;
         return (clientSocket);
     }
 
-    if (clientSocket == fd) {
-        responseStr.erase(0, bytesToSend);
-    } else {
-        cgiInputStr.erase(0, bytesToSend);
-    }
-
-    if (clientSocket != fd && cgiInputStr.size() == 0) {
+    if (clientSocket != fd) {
+        // The pipe stays open while the rest of the body is on its way
+        if (request.isReadingBody()) {
+            return (0);
+        }
         pipeIn = 0;
         return (clientSocket);
     }
-    return (0);
+    pipelinedRequests = 0;
+    // A streamed response empties the queue before it is complete
+    return (isFinished() ? fd : 0);
 }
 
 std::vector<Server>::const_iterator Client::findServer(const std::vector<Server>& servers, const std::string& host) const {
@@ -367,7 +924,7 @@ std::vector<Server>::const_iterator Client::findServer(const std::vector<Server>
     return (servers.begin());
 }
 
-void Client::matchUriAndResponseClient(const std::vector<Server>& servers, std::vector<pollfd>& fdsToAdd) {
+void Client::matchUri(const std::vector<Server>& servers) {
     std::string cookies = "Cookies:";
     if (request.getCookies().size() > 0) {
         for (std::map<std::string, std::string>::const_iterator it = request.getCookies().begin(); it != request.getCookies().end(); ++it) {
@@ -375,14 +932,28 @@ void Client::matchUriAndResponseClient(const std::vector<Server>& servers, std::
         }
     }
     logger.info() << "Request: " << getMethodString(request.getMethod()) << ' ' << request.getUri() << ' ' << request.getVersion() << ' ' << cookies << std::endl;
-    std::vector<Server>::const_iterator server = findServer(servers, request.getHeaders().at(HttpRequest::HEADER_HOST_KEY));
+    std::vector<Server>::const_iterator server = findServer(servers, request.getHeader(HEADER_HOST));
     std::vector<Location>::const_iterator location = (*server).matchUri(request.getUri());
+
+    requestServer = &(*server);
     if (location == (*server).getLocations().end()) {
-        responseStr = processRequest((*server).getConfig(), fdsToAdd);
+        requestConfig = &(*server).getConfig();
     } else {
-        responseStr = processRequest((*location).getConfig(), fdsToAdd);
+        requestConfig = &(*location).getConfig();
     }
-    request.clear();
+
+    requestCount++;
+    keepAlive = request.isKeepAlive() && (*server).getKeepaliveTimeout() > 0 && requestCount < (*server).getKeepaliveRequests();
+    setKeepaliveTimeout((*server).getKeepaliveTimeout());
+    updateConnection();
+    // gzip is the only coding offered: every client accepting deflate also accepts gzip, and deflate
+    // is sent zlib-wrapped by some servers and raw by others, so it would need a variant of its own
+    response.setCompression(requestConfig->getCompression(), request.acceptsEncoding("gzip"));
+    response.setCachePolicy(requestConfig->getCachePolicy());
+}
+
+void Client::updateConnection() {
+    response.setConnection(keepAlive, requestServer->getKeepaliveTimeout(), requestServer->getKeepaliveRequests() - requestCount);
 }
 
 static std::string findCgiPath(std::string path, const Configurations& config) {
@@ -404,80 +975,285 @@ static std::string findCgiPath(std::string path, const Configurations& config) {
     return ("");
 }
 
-std::string Client::processRequest(const Configurations& config, std::vector<pollfd>& fdsToAdd) {
+// Decides where the body goes as soon as the headers are in, so a rejected
+// request is answered without reading its body first
+void Client::routeBody(EventLoop& eventLoop, FdRegistry& registry) {
+    const Configurations& config = *requestConfig;
+
+    // Until the body is accepted, a response closes the connection, since the unread body would
+    // otherwise be taken for the next request
+    bool persistent = keepAlive;
+    keepAlive = false;
+    updateConnection();
+
+    bool accepted = false;
+    if (!rejectRequest(config)) {
+        std::string path = createPath(config.getRoot(), request.getUri());
+        std::string execPath = findCgiPath(path, config);
+        if (!config.getFastCgiPass().empty()) {
+            startFastCgi(config, path, eventLoop, registry);
+            if (upstreamFd != 0) {
+                fastCgiSink.attach(&cgiInput);
+                bodySink = &fastCgiSink;
+                accepted = true;
+            }
+        } else if (!execPath.empty()) {
+            createCgiProcess(config, execPath, path, eventLoop, registry);
+            if (cgiPid != 0) {
+                cgiSink.attach(&cgiInput);
+                bodySink = &cgiSink;
+                accepted = true;
+            }
+        } else if (request.getMethod() == POST) {
+            if (openUpload(config, path)) {
+                bodySink = &uploadSink;
+                accepted = true;
+            }
+        } else {
+            accepted = true;
+        }
+    }
+
+    if (accepted) {
+        keepAlive = persistent;
+        updateConnection();
+        request.acceptBody(bodySink);
+        return;
+    }
+
+    request.discard();
+    requestServer = NULL;
+    requestConfig = NULL;
+}
+
+void Client::responseClient(EventLoop& eventLoop, FdRegistry& registry) {
+    if (bodySink == &cgiSink) {
+        // The script is already running, it only has to see the end of its input
+        cgiSink.detach();
+        if (pipeIn != 0 && cgiInput.empty()) {
+            closeCgiInput(eventLoop, registry);
+        }
+    } else if (bodySink == &fastCgiSink) {
+        fastCgiSink.detach();
+    } else {
+        processRequest(*requestConfig, eventLoop, registry);
+    }
+    bodySink = NULL;
+    requestServer = NULL;
+    requestConfig = NULL;
+    request.clear();
+}
+
+// Only a chunked body can outgrow the limit, a declared length was checked with the headers
+bool Client::isBodyTooLarge() const {
+    return (requestConfig != NULL && request.getBodySize() > requestConfig->getClientBodySize());
+}
+
+void Client::rejectBody(EventLoop& eventLoop, FdRegistry& registry) {
+    // A script that already answered keeps its response, the connection just ends after it
+    bool answered = (bodySink == &cgiSink || bodySink == &fastCgiSink) && (!isCgiRunning() || cgiState != CGI_HEADERS);
+    if (bodySink == &cgiSink) {
+        terminateCgiProcess();
+        cgiState = CGI_HEADERS;
+        cgiInput.clear();
+        cgiSink.detach();
+        if (pipeIn != 0) {
+            closeCgiInput(eventLoop, registry);
+        }
+        if (pipeOut != 0) {
+            registry.remove(pipeOut);
+            eventLoop.unwatch(pipeOut);
+            close(pipeOut);
+            pipeOut = 0;
+        }
+        cgiOutputStr.clear();
+    }
+    if (bodySink == &fastCgiSink) {
+        if (upstreamFd != 0) {
+            closeUpstream(eventLoop, registry);
+        }
+        cgiState = CGI_HEADERS;
+        cgiInput.clear();
+        fastCgiSink.detach();
+        cgiOutputStr.clear();
+    }
+    uploadSink.abort();
+
+    keepAlive = false;
+    updateConnection();
+    if (!answered) {
+        response.createErrorResponse(output, 413, requestConfig->getErrorPages());
+    }
+    request.discard();
+    bodySink = NULL;
+    requestServer = NULL;
+    requestConfig = NULL;
+}
+
+void Client::closeCgiInput(EventLoop& eventLoop, FdRegistry& registry) {
+    registry.remove(pipeIn);
+    eventLoop.unwatch(pipeIn);
+    close(pipeIn);
+    pipeIn = 0;
+}
+
+bool Client::rejectRequest(const Configurations& config) {
     if (std::find(config.getMethods().begin(), config.getMethods().end(), request.getMethod()) == config.getMethods().end()) {
-        return (response.createErrorResponse(405, config.getRoot(), config.getErrorPages()));
+        response.createErrorResponse(output, 405, config.getErrorPages());
+        return (true);
     }
 
-    if (request.getBody().size() > config.getClientBodySize()) {
-        return (response.createErrorResponse(413, config.getRoot(), config.getErrorPages()));
+    if (request.getContentLength() > config.getClientBodySize()) {
+        response.createErrorResponse(output, 413, config.getErrorPages());
+        return (true);
     }
 
     if (config.getRedirect() != "") {
-        return (response.createResponseFromLocation(301, config.getRedirect()));
+        response.createResponseFromLocation(output, 301, config.getRedirect());
+        return (true);
+    }
+    return (false);
+}
+
+void Client::processRequest(const Configurations& config, EventLoop& eventLoop, FdRegistry& registry) {
+    if (rejectRequest(config)) {
+        return;
     }
 
     std::string path = createPath(config.getRoot(), request.getUri());
     std::string execPath = findCgiPath(path, config);
-    if (!execPath.empty()) {
-        return (createCgiProcess(config, execPath, path, fdsToAdd));
+    if (!config.getFastCgiPass().empty()) {
+        startFastCgi(config, path, eventLoop, registry);
+        return;
+    } else if (!execPath.empty()) {
+        createCgiProcess(config, execPath, path, eventLoop, registry);
+        return;
     } else if (request.getMethod() == GET) {
-        return (processGetRequest(config, path, request.getUri()));
+        processGetRequest(config, path, request.getUri());
+        return;
     } else if (request.getMethod() == POST) {
-        return (processPostRequest(config, path, request.getUri(), request.getHeaders()));
+        processPostRequest(config, request.getUri());
+        return;
     } else if (request.getMethod() == DELETE) {
-        return (processDeleteRequest(config, path));
+        processDeleteRequest(config, path);
+        return;
     }
-    return (response.createErrorResponse(501, config.getRoot(), config.getErrorPages()));
+    response.createErrorResponse(output, 501, config.getErrorPages());
 }
 
-std::string Client::processGetRequest(const Configurations& config, const std::string& path, const std::string& uri) {
+// Files too large for the cache are still sent from their .gz sibling when there is one
+std::string Client::findPrecompressed(const std::string& path, bool useStatic) {
+    if (!useStatic) {
+        return (path);
+    }
+
+    struct stat fileStat;
+    std::string gzipPath = path + ".gz";
+    if (stat(gzipPath.c_str(), &fileStat) == -1 || !S_ISREG(fileStat.st_mode)) {
+        return (path);
+    }
+    response.setEncoding("gzip");
+    return (gzipPath);
+}
+
+void Client::processGetRequest(const Configurations& config, const std::string& path, const std::string& uri) {
+    Preconditions preconditions = request.getPreconditions();
+    std::string indexPath = path + '/' + config.getIndex();
+    response.setRange(request.getHeader(HEADER_RANGE), request.getHeader(HEADER_IF_RANGE));
+
+    const Compression& compression = config.getCompression();
+    bool acceptsGzip = (compression.isEnabled() || compression.isStaticEnabled()) && request.acceptsEncoding("gzip");
+
+    // A cached file is served without touching the disk, a directory's index is looked up directly
+    if (requestServer != NULL) {
+        FileCache& cache = requestServer->getFileCache();
+        std::string filePath = (path[path.size() - 1] == '/') ? indexPath : path;
+        const GzipVariant* gzip = NULL;
+        const CachedFile* cached = acceptsGzip ? cache.getGzip(filePath, compression, gzip) : cache.get(filePath);
+        if (cached != NULL) {
+            response.createCachedFileResponse(output, *cached, gzip, preconditions, config.getErrorPages());
+            return;
+        }
+    }
+
     struct stat fileStat;
     if (stat(path.c_str(), &fileStat) == -1) {
-        return (response.createErrorResponse(404, config.getRoot(), config.getErrorPages()));
+        response.createErrorResponse(output, 404, config.getErrorPages());
+        return;
     }
-    std::string etag = request.getEtag();
 
     if (S_ISDIR(fileStat.st_mode)) {
         if (path[path.size() - 1] != '/') {
-            return (response.createResponseFromLocation(301, uri + '/'));
-        } else if (access((path + '/' + config.getIndex()).c_str(), F_OK) != -1) {
-            return (response.createFileResponse(path + '/' + config.getIndex(), etag, config.getRoot(), config.getErrorPages()));
+            response.createResponseFromLocation(output, 301, uri + '/');
+        } else if (access(indexPath.c_str(), F_OK) != -1) {
+            response.createFileResponse(output, findPrecompressed(indexPath, acceptsGzip && compression.isStaticEnabled()), preconditions, config.getErrorPages());
         } else if (config.getIsAutoindex()) {
-            return (response.createIndexResponse(path, uri, config.getRoot(), config.getErrorPages()));
+            response.createIndexResponse(output, path, uri, request.getQueryParameters(), requestServer->getAutoindexCache(), config.getErrorPages());
         } else {
-            return (response.createErrorResponse(403, config.getRoot(), config.getErrorPages()));
+            response.createErrorResponse(output, 403, config.getErrorPages());
         }
     } else if (S_ISREG(fileStat.st_mode)) {
-        return (response.createFileResponse(path, etag, config.getRoot(), config.getErrorPages()));
+        response.createFileResponse(output, findPrecompressed(path, acceptsGzip && compression.isStaticEnabled()), preconditions, config.getErrorPages());
     } else {
-        return (response.createErrorResponse(404, config.getRoot(), config.getErrorPages()));
+        response.createErrorResponse(output, 404, config.getErrorPages());
     }
 }
 
-std::string Client::processPostRequest(const Configurations& config, const std::string& path, const std::string& uri, const std::map<std::string, std::string>& headers) {
-    if (request.getBody().empty()) {
-        return (response.createErrorResponse(400, config.getRoot(), config.getErrorPages()));
+// If-Match and If-Unmodified-Since keep a client from changing a file it last saw in another state
+bool Client::rejectPrecondition(const Configurations& config, const std::string& path) {
+    struct stat fileStat;
+    bool exists = stat(path.c_str(), &fileStat) == 0;
+    std::string etag = exists ? HttpResponse::generateEtag(fileStat) : "";
+    if (request.getPreconditions().evaluate(etag, exists ? fileStat.st_mtime : 0, exists, false) == Preconditions::PRECONDITION_PASSED) {
+        return (false);
     }
 
-    std::map<std::string, std::string>::const_iterator it = headers.find(HttpRequest::HEADER_CONTENT_TYPE_KEY);
-    const std::string& contentType = (it != headers.end()) ? it->second : "application/octet-stream";
+    response.createErrorResponse(output, 412, config.getErrorPages());
+    return (true);
+}
+
+bool Client::openUpload(const Configurations& config, const std::string& path) {
+    std::string contentType = request.hasHeader(HEADER_CONTENT_TYPE) ? request.getHeader(HEADER_CONTENT_TYPE) : "application/octet-stream";
     if (contentType != "text/plain" && contentType != "application/octet-stream") {
-        return (response.createErrorResponse(415, config.getRoot(), config.getErrorPages()));
+        response.createErrorResponse(output, 415, config.getErrorPages());
+        return (false);
+    }
+
+    if (rejectPrecondition(config, path)) {
+        return (false);
     }
 
     if (access(path.c_str(), F_OK) != -1) {
-        return (response.createErrorResponse(409, config.getRoot(), config.getErrorPages()));
+        response.createErrorResponse(output, 409, config.getErrorPages());
+        return (false);
     }
-    std::ofstream file(path.c_str());
-    if (!file.is_open()) {
-        return (response.createErrorResponse(500, config.getRoot(), config.getErrorPages()));
+
+    if (!uploadSink.open(path)) {
+        logger.perror("mkstemp");
+        response.createErrorResponse(output, 500, config.getErrorPages());
+        return (false);
     }
+    return (true);
+}
 
-    file << request.getBody();
-    file.close();
+// The body was written by the upload sink while it arrived, only the file is left to publish
+void Client::processPostRequest(const Configurations& config, const std::string& uri) {
+    if (bodySink != &uploadSink) {
+        response.createErrorResponse(output, 400, config.getErrorPages());
+        return;
+    }
 
-    return (response.createResponseFromLocation(201, uri));
+    int error = uploadSink.commit();
+    if (error == EEXIST) {
+        response.createErrorResponse(output, 409, config.getErrorPages());
+        return;
+    }
+    if (error != 0) {
+        response.createErrorResponse(output, 500, config.getErrorPages());
+        return;
+    }
+
+    response.createResponseFromLocation(output, 201, uri);
 }
 
 static bool isDirectory(const std::string& path) {
@@ -490,27 +1266,36 @@ static bool isDirectory(const std::string& path) {
     return S_ISDIR(pathStat.st_mode);
 }
 
-std::string Client::processDeleteRequest(const Configurations& config, const std::string& path) {
+void Client::processDeleteRequest(const Configurations& config, const std::string& path) {
     if (access(path.c_str(), F_OK) == -1) {
-        return (response.createErrorResponse(404, config.getRoot(), config.getErrorPages()));
+        response.createErrorResponse(output, 404, config.getErrorPages());
+        return;
     }
     if (access(path.c_str(), W_OK) == -1) {
-        return (response.createErrorResponse(403, config.getRoot(), config.getErrorPages()));
+        response.createErrorResponse(output, 403, config.getErrorPages());
+        return;
+    }
+    if (rejectPrecondition(config, path)) {
+        return;
     }
 
     if (isDirectory(path)) {
         if (path[path.size() - 1] != '/') {
-            return (response.createErrorResponse(409, config.getRoot(), config.getErrorPages()));
+            response.createErrorResponse(output, 409, config.getErrorPages());
+            return;
         }
 
         std::string command = "rm -rf " + path;
         int result = std::system(command.c_str());
         if (result == 0)
-            return (response.createResponseFromStatus(204));
-        return (response.createErrorResponse(500, config.getRoot(), config.getErrorPages()));
+            response.createResponseFromStatus(output, 204);
+        else
+            response.createErrorResponse(output, 500, config.getErrorPages());
+        return;
     } else if (remove(path.c_str()) == -1) {
-        return (response.createErrorResponse(500, config.getRoot(), config.getErrorPages()));
+        response.createErrorResponse(output, 500, config.getErrorPages());
+        return;
     }
 
-    return (response.createResponseFromStatus(204));
+    response.createResponseFromStatus(output, 204);
 }
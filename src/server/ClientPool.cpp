@@ -0,0 +1,62 @@
+#include "ClientPool.hpp"
+
+const size_t ClientPool::CHUNK_SIZE = 64;
+
+ClientPool::ClientPool() : chunks(), freeList(), activeCount(0) {}
+
+// Live connections are never copied, a copied pool always starts empty
+ClientPool::ClientPool(const ClientPool &other) : chunks(), freeList(), activeCount(0) {
+    (void)other;
+}
+
+ClientPool &ClientPool::operator=(const ClientPool &other) {
+    if (this != &other) {
+        destroy();
+    }
+    return (*this);
+}
+
+ClientPool::~ClientPool() {
+    destroy();
+}
+
+void ClientPool::destroy() {
+    for (std::vector<Client *>::iterator it = chunks.begin(); it != chunks.end(); ++it) {
+        delete[] *it;
+    }
+    chunks.clear();
+    freeList.clear();
+    activeCount = 0;
+}
+
+void ClientPool::grow() {
+    Client *chunk = new Client[CHUNK_SIZE];
+    chunks.push_back(chunk);
+
+    freeList.reserve(freeList.size() + CHUNK_SIZE);
+    for (size_t i = CHUNK_SIZE; i > 0; --i) {
+        freeList.push_back(&chunk[i - 1]);
+    }
+}
+
+Client *ClientPool::acquire(int fd) {
+    if (freeList.empty()) {
+        grow();
+    }
+
+    Client *client = freeList.back();
+    freeList.pop_back();
+    client->reset(fd);
+    ++activeCount;
+    return (client);
+}
+
+void ClientPool::release(Client *client) {
+    client->reset(0);
+    freeList.push_back(client);
+    --activeCount;
+}
+
+size_t ClientPool::size() const {
+    return (activeCount);
+}
@@ -0,0 +1,118 @@
+#include "EpollEventLoop.hpp"
+
+#ifdef __linux__
+
+#include <unistd.h>
+
+#include "utils.h"
+
+const size_t EpollEventLoop::MAX_EVENTS = 1024;
+
+EpollEventLoop::EpollEventLoop(bool edgeTriggered) : epollFd(-1), edgeTriggered(edgeTriggered), interests(), events(MAX_EVENTS) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        throw createError("epoll_create1");
+    }
+}
+
+EpollEventLoop::~EpollEventLoop() {
+    if (epollFd != -1) {
+        close(epollFd);
+    }
+}
+
+uint32_t EpollEventLoop::toEpollEvents(short events) const {
+    uint32_t epollEvents = 0;
+    if (events & POLLIN) {
+        epollEvents |= EPOLLIN;
+    }
+    if (events & POLLOUT) {
+        epollEvents |= EPOLLOUT;
+    }
+    if (edgeTriggered) {
+        epollEvents |= EPOLLET;
+    }
+    return (epollEvents);
+}
+
+short EpollEventLoop::fromEpollEvents(uint32_t events) {
+    short pollEvents = 0;
+    if (events & EPOLLIN) {
+        pollEvents |= POLLIN;
+    }
+    if (events & EPOLLOUT) {
+        pollEvents |= POLLOUT;
+    }
+    if (events & EPOLLERR) {
+        pollEvents |= POLLERR;
+    }
+    if (events & (EPOLLHUP | EPOLLRDHUP)) {
+        pollEvents |= POLLHUP;
+    }
+    return (pollEvents);
+}
+
+void EpollEventLoop::watch(int fd, short events) {
+    if (fd < 0) {
+        return;
+    }
+    if (static_cast<size_t>(fd) >= interests.size()) {
+        interests.resize(fd + 1, -1);
+    }
+    if (interests[fd] == events) {
+        return;
+    }
+
+    struct epoll_event event;
+    event.events = toEpollEvents(events);
+    event.data.fd = fd;
+
+    int operation = (interests[fd] == -1) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(epollFd, operation, fd, &event) == -1) {
+        if (operation == EPOLL_CTL_ADD && errno == EEXIST) {
+            operation = EPOLL_CTL_MOD;
+        } else if (operation == EPOLL_CTL_MOD && errno == ENOENT) {
+            operation = EPOLL_CTL_ADD;
+        } else {
+            throw createError("epoll_ctl");
+        }
+        if (epoll_ctl(epollFd, operation, fd, &event) == -1) {
+            throw createError("epoll_ctl");
+        }
+    }
+    interests[fd] = events;
+}
+
+void EpollEventLoop::unwatch(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= interests.size() || interests[fd] == -1) {
+        return;
+    }
+
+    // The kernel already drops closed fds from the set, so a failure here is not an error
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+    interests[fd] = -1;
+}
+
+int EpollEventLoop::wait(std::vector<struct pollfd> &ready, int timeout) {
+    ready.clear();
+
+    int affected = epoll_wait(epollFd, events.data(), events.size(), timeout);
+    if (affected < 0) {
+        return (affected);
+    }
+
+    for (int i = 0; i < affected; ++i) {
+        struct pollfd pfd;
+        pfd.fd = events[i].data.fd;
+        pfd.events = interests[pfd.fd];
+        pfd.revents = fromEpollEvents(events[i].events);
+        ready.push_back(pfd);
+    }
+    return (affected);
+}
+
+const std::string &EpollEventLoop::getName() const {
+    return (edgeTriggered ? EPOLL_EDGE_BACKEND : EPOLL_BACKEND);
+}
+
+#endif
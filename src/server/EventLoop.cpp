@@ -0,0 +1,30 @@
+#include "EventLoop.hpp"
+
+#include "EpollEventLoop.hpp"
+#include "PollEventLoop.hpp"
+
+const std::string EventLoop::POLL_BACKEND = "poll";
+const std::string EventLoop::EPOLL_BACKEND = "epoll";
+const std::string EventLoop::EPOLL_EDGE_BACKEND = "epoll_et";
+#ifdef __linux__
+const std::string EventLoop::DEFAULT_BACKEND = EventLoop::EPOLL_BACKEND;
+#else
+const std::string EventLoop::DEFAULT_BACKEND = EventLoop::POLL_BACKEND;
+#endif
+
+EventLoop::~EventLoop() {}
+
+bool EventLoop::isValidBackend(const std::string &backend) {
+    return (backend == POLL_BACKEND || backend == EPOLL_BACKEND || backend == EPOLL_EDGE_BACKEND);
+}
+
+EventLoop *EventLoop::create(const std::string &backend) {
+#ifdef __linux__
+    if (backend == EPOLL_BACKEND) {
+        return (new EpollEventLoop(false));
+    } else if (backend == EPOLL_EDGE_BACKEND) {
+        return (new EpollEventLoop(true));
+    }
+#endif
+    return (new PollEventLoop());
+}
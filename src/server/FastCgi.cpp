@@ -0,0 +1,338 @@
+#include "FastCgi.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+const size_t FastCgiRecord::HEADER_SIZE = 8;
+const size_t FastCgiRecord::MAX_CONTENT_SIZE = 65535;
+const int FastCgiRecord::REQUEST_ID = 1;
+
+const size_t FastCgiPool::MAX_IDLE_CONNECTIONS = 8;
+
+static const unsigned char FCGI_VERSION = 1;
+static const unsigned char FCGI_RESPONDER = 1;
+static const unsigned char FCGI_KEEP_CONN = 1;
+static const unsigned char FCGI_REQUEST_COMPLETE = 0;
+
+static std::string createHeader(FastCgiRecordType type, size_t contentSize, size_t paddingSize) {
+    std::string header(FastCgiRecord::HEADER_SIZE, '\0');
+    header[0] = FCGI_VERSION;
+    header[1] = type;
+    header[2] = (FastCgiRecord::REQUEST_ID >> 8) & 0xff;
+    header[3] = FastCgiRecord::REQUEST_ID & 0xff;
+    header[4] = (contentSize >> 8) & 0xff;
+    header[5] = contentSize & 0xff;
+    header[6] = paddingSize;
+    return (header);
+}
+
+// Content is padded to a multiple of 8 bytes, as the specification recommends
+static void pushRecord(OutputQueue &output, FastCgiRecordType type, const char *data, size_t size) {
+    size_t paddingSize = (8 - size % 8) % 8;
+    std::string record = createHeader(type, size, paddingSize);
+    record.append(data, size);
+    record.append(paddingSize, '\0');
+    output.push(record);
+}
+
+void FastCgiRecord::pushBeginRequest(OutputQueue &output) {
+    char body[8] = {0, FCGI_RESPONDER, FCGI_KEEP_CONN, 0, 0, 0, 0, 0};
+    pushRecord(output, FCGI_BEGIN_REQUEST, body, sizeof(body));
+}
+
+static void appendLength(std::string &stream, size_t length) {
+    if (length < 128) {
+        stream += static_cast<char>(length);
+        return;
+    }
+    stream += static_cast<char>(((length >> 24) & 0x7f) | 0x80);
+    stream += static_cast<char>((length >> 16) & 0xff);
+    stream += static_cast<char>((length >> 8) & 0xff);
+    stream += static_cast<char>(length & 0xff);
+}
+
+void FastCgiRecord::pushParams(OutputQueue &output, const std::map<std::string, std::string> &params) {
+    std::string stream;
+    for (std::map<std::string, std::string>::const_iterator it = params.begin(); it != params.end(); ++it) {
+        appendLength(stream, it->first.size());
+        appendLength(stream, it->second.size());
+        stream += it->first;
+        stream += it->second;
+    }
+    pushStream(output, FCGI_PARAMS, stream.data(), stream.size());
+    pushStream(output, FCGI_PARAMS, NULL, 0);
+}
+
+void FastCgiRecord::pushStream(OutputQueue &output, FastCgiRecordType type, const char *data, size_t size) {
+    if (size == 0) {
+        pushRecord(output, type, NULL, 0);
+        return;
+    }
+    for (size_t offset = 0; offset < size; offset += MAX_CONTENT_SIZE) {
+        size_t length = std::min(MAX_CONTENT_SIZE, size - offset);
+        pushRecord(output, type, data + offset, length);
+    }
+}
+
+FastCgiReader::FastCgiReader() : logger("FASTCGI"), pending(), ended(false), appStatus(0), protocolStatus(FCGI_REQUEST_COMPLETE) {}
+
+FastCgiReader::FastCgiReader(const FastCgiReader &other) : logger("FASTCGI"), pending(), ended(false), appStatus(0), protocolStatus(FCGI_REQUEST_COMPLETE) {
+    *this = other;
+}
+
+FastCgiReader &FastCgiReader::operator=(const FastCgiReader &other) {
+    if (this != &other) {
+        logger = other.logger;
+        pending = other.pending;
+        ended = other.ended;
+        appStatus = other.appStatus;
+        protocolStatus = other.protocolStatus;
+    }
+    return (*this);
+}
+
+FastCgiReader::~FastCgiReader() {}
+
+bool FastCgiReader::read(const char *data, size_t size, std::string &output) {
+    pending.append(data, size);
+
+    size_t offset = 0;
+    while (!ended && pending.size() - offset >= FastCgiRecord::HEADER_SIZE) {
+        const unsigned char *header = reinterpret_cast<const unsigned char *>(pending.data() + offset);
+        if (header[0] != FCGI_VERSION) {
+            return (false);
+        }
+        int requestId = (header[2] << 8) | header[3];
+        size_t contentSize = (header[4] << 8) | header[5];
+        size_t recordSize = FastCgiRecord::HEADER_SIZE + contentSize + header[6];
+        if (pending.size() - offset < recordSize) {
+            break;
+        }
+
+        const char *content = pending.data() + offset + FastCgiRecord::HEADER_SIZE;
+        // Management records carry the id 0 and need no answer from a client
+        if (requestId == FastCgiRecord::REQUEST_ID) {
+            if (header[1] == FCGI_STDOUT) {
+                output.append(content, contentSize);
+            } else if (header[1] == FCGI_STDERR && contentSize > 0) {
+                logger.warn() << std::string(content, contentSize) << std::endl;
+            } else if (header[1] == FCGI_END_REQUEST) {
+                if (contentSize < 8) {
+                    return (false);
+                }
+                const unsigned char *body = reinterpret_cast<const unsigned char *>(content);
+                appStatus = (static_cast<long>(body[0]) << 24) | (body[1] << 16) | (body[2] << 8) | body[3];
+                protocolStatus = body[4];
+                ended = true;
+            }
+        }
+        offset += recordSize;
+    }
+    pending.erase(0, offset);
+    return (true);
+}
+
+bool FastCgiReader::isEnded() const {
+    return (ended);
+}
+
+// The application completed the request and nothing trails it, so the connection can serve another
+bool FastCgiReader::isReusable() const {
+    return (ended && protocolStatus == FCGI_REQUEST_COMPLETE && pending.empty());
+}
+
+// The application status plays the part of a script's exit code
+bool FastCgiReader::hasFailed() const {
+    return (protocolStatus != FCGI_REQUEST_COMPLETE || appStatus != 0);
+}
+
+void FastCgiReader::reset() {
+    std::string().swap(pending);
+    ended = false;
+    appStatus = 0;
+    protocolStatus = FCGI_REQUEST_COMPLETE;
+}
+
+FastCgiBodySink::FastCgiBodySink() : queue(NULL) {}
+
+FastCgiBodySink::FastCgiBodySink(const FastCgiBodySink &other) : queue(NULL) {
+    *this = other;
+}
+
+// The queue belongs to the owner of the original sink, so the copy is detached
+FastCgiBodySink &FastCgiBodySink::operator=(const FastCgiBodySink &other) {
+    if (this != &other) {
+        queue = NULL;
+    }
+    return (*this);
+}
+
+FastCgiBodySink::~FastCgiBodySink() {}
+
+void FastCgiBodySink::attach(OutputQueue *queue) {
+    this->queue = queue;
+}
+
+void FastCgiBodySink::detach() {
+    queue = NULL;
+}
+
+// Ends the stdin stream, the application only answers once it has seen it
+void FastCgiBodySink::finish() {
+    if (queue != NULL) {
+        FastCgiRecord::pushStream(*queue, FCGI_STDIN, NULL, 0);
+    }
+    queue = NULL;
+}
+
+void FastCgiBodySink::write(const char *data, size_t size) {
+    if (queue == NULL || size == 0) {
+        return;
+    }
+    FastCgiRecord::pushStream(*queue, FCGI_STDIN, data, size);
+}
+
+bool FastCgiBodySink::failed() const {
+    return (false);
+}
+
+FastCgiPool::FastCgiPool() : logger("FASTCGI"), idle() {}
+
+// Connections belong to the pool that opened them, a copy starts empty
+FastCgiPool::FastCgiPool(const FastCgiPool &other) : logger("FASTCGI"), idle() {
+    (void)other;
+}
+
+FastCgiPool &FastCgiPool::operator=(const FastCgiPool &other) {
+    if (this != &other) {
+        clear();
+    }
+    return (*this);
+}
+
+FastCgiPool::~FastCgiPool() {
+    clear();
+}
+
+void FastCgiPool::clear() {
+    for (std::map<std::string, std::vector<int> >::iterator it = idle.begin(); it != idle.end(); ++it) {
+        for (std::vector<int>::iterator fd = it->second.begin(); fd != it->second.end(); ++fd) {
+            close(*fd);
+        }
+    }
+    idle.clear();
+}
+
+bool FastCgiPool::isValidAddress(const std::string &address) {
+    struct sockaddr_storage storage;
+    socklen_t length;
+    return (parseAddress(address, storage, length));
+}
+
+bool FastCgiPool::parseAddress(const std::string &address, struct sockaddr_storage &storage, socklen_t &length) {
+    std::memset(&storage, 0, sizeof(storage));
+
+    if (address.compare(0, 5, "unix:") == 0) {
+        struct sockaddr_un *unixAddress = reinterpret_cast<struct sockaddr_un *>(&storage);
+        std::string path = address.substr(5);
+        if (path.empty() || path.size() >= sizeof(unixAddress->sun_path)) {
+            return (false);
+        }
+        unixAddress->sun_family = AF_UNIX;
+        std::memcpy(unixAddress->sun_path, path.c_str(), path.size() + 1);
+        length = sizeof(struct sockaddr_un);
+        return (true);
+    }
+
+    size_t colon = address.find_last_of(':');
+    if (colon == std::string::npos || colon + 1 == address.size()) {
+        return (false);
+    }
+    std::string host = address.substr(0, colon);
+    std::string port = address.substr(colon + 1);
+    char *end;
+    long portNumber = std::strtol(port.c_str(), &end, 10);
+    if (*end != '\0' || portNumber <= 0 || portNumber > 65535) {
+        return (false);
+    }
+
+    struct sockaddr_in *inetAddress = reinterpret_cast<struct sockaddr_in *>(&storage);
+    inetAddress->sin_family = AF_INET;
+    inetAddress->sin_port = htons(portNumber);
+    if (host == "localhost") {
+        host = "127.0.0.1";
+    }
+    if (inet_pton(AF_INET, host.c_str(), &inetAddress->sin_addr) != 1) {
+        return (false);
+    }
+    length = sizeof(struct sockaddr_in);
+    return (true);
+}
+
+// Reuses an idle connection when one is still open, otherwise starts a non-blocking connect
+int FastCgiPool::acquire(const std::string &address) {
+    std::vector<int> &connections = idle[address];
+    while (!connections.empty()) {
+        int fd = connections.back();
+        connections.pop_back();
+        if (isAlive(fd)) {
+            return (fd);
+        }
+        close(fd);
+    }
+    return (connectTo(address));
+}
+
+void FastCgiPool::release(const std::string &address, int fd) {
+    std::vector<int> &connections = idle[address];
+    if (connections.size() >= MAX_IDLE_CONNECTIONS) {
+        close(fd);
+        return;
+    }
+    connections.push_back(fd);
+}
+
+int FastCgiPool::connectTo(const std::string &address) {
+    struct sockaddr_storage storage;
+    socklen_t length;
+    if (!parseAddress(address, storage, length)) {
+        logger.error() << "Invalid fastcgi address " << address << std::endl;
+        return (-1);
+    }
+
+    int fd = socket(storage.ss_family, SOCK_STREAM, 0);
+    if (fd == -1) {
+        logger.perror("socket");
+        return (-1);
+    }
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1 || fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) {
+        logger.perror("fcntl");
+        close(fd);
+        return (-1);
+    }
+
+    // A connect still in progress completes once the socket turns writable
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&storage), length) == -1 && errno != EINPROGRESS) {
+        logger.perror("connect");
+        close(fd);
+        return (-1);
+    }
+    return (fd);
+}
+
+// An idle connection has nothing to read, so readable means the application closed it
+bool FastCgiPool::isAlive(int fd) {
+    char byte;
+    ssize_t result = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
@@ -0,0 +1,57 @@
+#include "FdRegistry.hpp"
+
+#include <cstddef>
+
+static FdEntry createEmptyEntry();
+
+const FdEntry FdRegistry::EMPTY_ENTRY = createEmptyEntry();
+
+FdRegistry::FdRegistry() : entries() {}
+
+FdRegistry::FdRegistry(const FdRegistry &other) {
+    *this = other;
+}
+
+FdRegistry &FdRegistry::operator=(const FdRegistry &other) {
+    if (this != &other) {
+        entries = other.entries;
+    }
+    return (*this);
+}
+
+FdRegistry::~FdRegistry() {}
+
+void FdRegistry::add(int fd, FdRole role, ServerManager *server, Client *client) {
+    if (fd < 0) {
+        return;
+    }
+    if (static_cast<size_t>(fd) >= entries.size()) {
+        entries.resize(fd + 1, EMPTY_ENTRY);
+    }
+
+    entries[fd].role = role;
+    entries[fd].server = server;
+    entries[fd].client = client;
+}
+
+void FdRegistry::remove(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= entries.size()) {
+        return;
+    }
+    entries[fd] = EMPTY_ENTRY;
+}
+
+const FdEntry &FdRegistry::get(int fd) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= entries.size()) {
+        return (EMPTY_ENTRY);
+    }
+    return (entries[fd]);
+}
+
+static FdEntry createEmptyEntry() {
+    FdEntry entry;
+    entry.role = FD_NONE;
+    entry.server = NULL;
+    entry.client = NULL;
+    return (entry);
+}
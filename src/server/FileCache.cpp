@@ -0,0 +1,201 @@
+#include "FileCache.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "HttpResponse.hpp"
+#include "utils.h"
+
+const off_t FileCache::MAX_FILE_SIZE = 1024 * 1024;                // 1 MB
+const long long FileCache::REVALIDATE_INTERVAL_IN_MILLIS = 1000;  // 1 second
+const int FileCache::STATIC_GZIP_VARIANT = 0;
+
+FileCache::FileCache() : maxSize(0), usedSize(0), entries(), index() {}
+
+FileCache::FileCache(size_t maxSize) : maxSize(maxSize), usedSize(0), entries(), index() {}
+
+// Entries are only filled while serving, a copy keeps the limit and starts empty
+FileCache::FileCache(const FileCache &other) : maxSize(other.maxSize), usedSize(0), entries(), index() {}
+
+FileCache &FileCache::operator=(const FileCache &other) {
+    if (this != &other) {
+        maxSize = other.maxSize;
+        usedSize = 0;
+        entries.clear();
+        index.clear();
+    }
+    return (*this);
+}
+
+FileCache::~FileCache() {}
+
+const CachedFile *FileCache::get(const std::string &path) {
+    if (maxSize == 0) {
+        return (NULL);
+    }
+
+    long long now = getCurrentTimeMillis();
+    std::map<std::string, EntryList::iterator>::iterator found = index.find(path);
+    if (found != index.end()) {
+        EntryList::iterator entry = found->second;
+        if (isFresh(path, entry->second, now)) {
+            entries.splice(entries.begin(), entries, entry);
+            return (&entry->second);
+        }
+        erase(entry);
+    }
+
+    // Loaded straight into its node, so the content is never copied
+    entries.push_front(std::make_pair(path, CachedFile()));
+    CachedFile &cached = entries.front().second;
+    if (!load(path, cached)) {
+        entries.pop_front();
+        return (NULL);
+    }
+    cached.validatedAt = now;
+    index[path] = entries.begin();
+    usedSize += cached.content.size();
+    trim();
+    return (&cached);
+}
+
+const CachedFile *FileCache::getGzip(const std::string &path, const Compression &compression, const GzipVariant *&gzip) {
+    gzip = NULL;
+    if (get(path) == NULL) {
+        return (NULL);
+    }
+
+    CachedFile &cached = entries.front().second;
+    if (compression.isStaticEnabled()) {
+        gzip = findGzip(path, cached, STATIC_GZIP_VARIANT);
+    }
+    if (gzip == NULL && compression.shouldCompress(cached.contentType, cached.content.size())) {
+        gzip = findGzip(path, cached, compression.getLevel());
+    }
+    return (&cached);
+}
+
+// Made on the first request for it, a variant that isn't smaller is kept empty so it isn't tried again
+const GzipVariant *FileCache::findGzip(const std::string &path, CachedFile &file, int key) {
+    std::map<int, GzipVariant>::iterator found = file.gzipVariants.find(key);
+    if (found == file.gzipVariants.end()) {
+        found = file.gzipVariants.insert(std::make_pair(key, GzipVariant())).first;
+        if (loadGzip(path, file, key, found->second)) {
+            usedSize += found->second.content.size();
+            trim();
+        }
+    }
+    return (found->second.content.empty() ? NULL : &found->second);
+}
+
+// The entry just used sits at the front, so it is never the one evicted
+void FileCache::trim() {
+    while (usedSize > maxSize && entries.size() > 1) {
+        erase(--entries.end());
+    }
+}
+
+size_t FileCache::size() const {
+    return (usedSize);
+}
+
+// Within the interval an entry is trusted as is, past it a stat tells whether the file changed
+bool FileCache::isFresh(const std::string &path, CachedFile &file, long long now) const {
+    if (now - file.validatedAt < REVALIDATE_INTERVAL_IN_MILLIS) {
+        return (true);
+    }
+
+    struct stat fileInfo;
+    if (stat(path.c_str(), &fileInfo) == -1 || fileInfo.st_mtime != file.mtime || getMtimeNsec(fileInfo) != file.mtimeNsec || fileInfo.st_size != file.size || fileInfo.st_ino != file.inode) {
+        return (false);
+    }
+    for (std::map<int, GzipVariant>::const_iterator it = file.gzipVariants.begin(); it != file.gzipVariants.end(); ++it) {
+        const GzipVariant &variant = it->second;
+        if (!variant.path.empty() && (stat(variant.path.c_str(), &fileInfo) == -1 || fileInfo.st_mtime != variant.mtime || getMtimeNsec(fileInfo) != variant.mtimeNsec || fileInfo.st_size != variant.size)) {
+            return (false);
+        }
+    }
+    file.validatedAt = now;
+    return (true);
+}
+
+bool FileCache::load(const std::string &path, CachedFile &file) const {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return (false);
+    }
+
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) == -1 || !S_ISREG(fileInfo.st_mode) || fileInfo.st_size > MAX_FILE_SIZE || static_cast<size_t>(fileInfo.st_size) > maxSize) {
+        close(fd);
+        return (false);
+    }
+
+    std::string content(fileInfo.st_size, '\0');
+    size_t offset = 0;
+    while (offset < content.size()) {
+        ssize_t bytesRead = read(fd, &content[offset], content.size() - offset);
+        if (bytesRead <= 0) {
+            close(fd);
+            return (false);
+        }
+        offset += bytesRead;
+    }
+    close(fd);
+
+    file.content = SharedBuffer(content);
+    file.contentType = HttpResponse::getMimeType(path);
+    file.lastModified = HttpResponse::getLastModified(fileInfo);
+    file.etag = HttpResponse::generateEtag(fileInfo);
+    file.mtime = fileInfo.st_mtime;
+    file.mtimeNsec = getMtimeNsec(fileInfo);
+    file.size = fileInfo.st_size;
+    file.inode = fileInfo.st_ino;
+    return (true);
+}
+
+// A precompressed sibling is preferred, it was made offline at the best level
+bool FileCache::loadGzip(const std::string &path, const CachedFile &file, int key, GzipVariant &variant) const {
+    variant.mtime = 0;
+    variant.mtimeNsec = 0;
+    variant.size = 0;
+    if (key == STATIC_GZIP_VARIANT) {
+        std::string gzipPath = path + ".gz";
+        CachedFile sibling;
+        if (!load(gzipPath, sibling)) {
+            return (false);
+        }
+        variant.content = sibling.content;
+        variant.etag = sibling.etag;
+        variant.path = gzipPath;
+        variant.mtime = sibling.mtime;
+        variant.mtimeNsec = sibling.mtimeNsec;
+        variant.size = sibling.size;
+        return (true);
+    }
+
+    std::string compressed;
+    if (!gzipCompress(file.content.get(), key, compressed) || compressed.size() >= file.content.size()) {
+        return (false);
+    }
+    variant.content = SharedBuffer(compressed);
+    // Each encoding of the file is a representation of its own and needs its own tag, the level
+    // is part of it since every level encodes the file differently
+    variant.etag = file.etag.substr(0, file.etag.size() - 1) + "-gzip" + numberToString(key) + "\"";
+    return (true);
+}
+
+size_t FileCache::getEntrySize(const CachedFile &file) {
+    size_t size = file.content.size();
+    for (std::map<int, GzipVariant>::const_iterator it = file.gzipVariants.begin(); it != file.gzipVariants.end(); ++it) {
+        size += it->second.content.size();
+    }
+    return (size);
+}
+
+void FileCache::erase(EntryList::iterator entry) {
+    usedSize -= getEntrySize(entry->second);
+    index.erase(entry->first);
+    entries.erase(entry);
+}
@@ -0,0 +1,97 @@
+#include "HeaderTable.hpp"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cstring>
+
+const size_t HeaderTable::RESERVED_FIELDS = 32;
+
+// Indexed by HeaderId
+static const char *HEADER_NAMES[HEADER_UNKNOWN] = {
+    "host",
+    "content-length",
+    "content-type",
+    "cookie",
+    "if-none-match",
+    "connection",
+    "transfer-encoding",
+    "accept-encoding",
+    "range",
+    "if-range",
+    "if-match",
+    "if-modified-since",
+    "if-unmodified-since",
+};
+
+HeaderTable::HeaderTable() : fields() {
+    fields.reserve(RESERVED_FIELDS);
+    std::fill(known, known + HEADER_UNKNOWN, -1);
+}
+
+HeaderTable::HeaderTable(const HeaderTable &other) {
+    *this = other;
+}
+
+HeaderTable &HeaderTable::operator=(const HeaderTable &other) {
+    if (this != &other) {
+        fields = other.fields;
+        std::copy(other.known, other.known + HEADER_UNKNOWN, known);
+    }
+    return (*this);
+}
+
+HeaderTable::~HeaderTable() {}
+
+// A repeated header replaces the earlier one on lookup
+void HeaderTable::add(const HeaderField &field) {
+    if (field.id != HEADER_UNKNOWN) {
+        known[field.id] = fields.size();
+    }
+    fields.push_back(field);
+}
+
+// Keeps the capacity, so the next request on the connection does not allocate
+void HeaderTable::clear() {
+    fields.clear();
+    std::fill(known, known + HEADER_UNKNOWN, -1);
+}
+
+size_t HeaderTable::size() const {
+    return (fields.size());
+}
+
+const HeaderField &HeaderTable::at(size_t index) const {
+    return (fields.at(index));
+}
+
+const HeaderField *HeaderTable::find(HeaderId id) const {
+    if (id == HEADER_UNKNOWN || known[id] == -1) {
+        return (NULL);
+    }
+    return (&fields[known[id]]);
+}
+
+const HeaderField *HeaderTable::find(const std::string &buffer, const std::string &name) const {
+    HeaderId id = intern(name.c_str(), name.size());
+    if (id != HEADER_UNKNOWN) {
+        return (find(id));
+    }
+
+    for (size_t i = fields.size(); i > 0; --i) {
+        const HeaderField &field = fields[i - 1];
+        if (field.keyLength == name.size() && strncasecmp(buffer.c_str() + field.keyStart, name.c_str(), name.size()) == 0) {
+            return (&field);
+        }
+    }
+    return (NULL);
+}
+
+HeaderId HeaderTable::intern(const char *key, size_t length) {
+    for (int id = 0; id < HEADER_UNKNOWN; ++id) {
+        if (std::strlen(HEADER_NAMES[id]) == length && strncasecmp(HEADER_NAMES[id], key, length) == 0) {
+            return (static_cast<HeaderId>(id));
+        }
+    }
+    return (HEADER_UNKNOWN);
+}
@@ -3,22 +3,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 
 #include "utils.h"
 
-const std::string HttpRequest::HEADER_HOST_KEY = "host";
-const std::string HttpRequest::HEADER_COOKIES_KEY = "cookie";
 const std::string HttpRequest::URI_CHARACTERS = "ABCDEFGHIJKLMNOPQRSTUVXWYZabcdefghijklmnopqrstuvxwyz0123456789-_.~/?:@&=+$,#";
-const std::string HttpRequest::HEADER_VALUE_CHARACTERS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-!@#$%^&*()_+|~=`{}[];:'\",.<>/? \t\r\n";
+// No control character but HTAB, a CR or LF inside a value could smuggle a header into the CGI environment
+const std::string HttpRequest::HEADER_VALUE_CHARACTERS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-!@#$%^&*()_+|~=`{}[];:'\",.<>/? \t";
 const std::string HttpRequest::HEADER_KEY_CHARACTERS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-";
 const std::string HttpRequest::HTTP_VERSION = "HTTP/1.1";
-const std::string HttpRequest::CONTENT_LENTH_HEADER_KEY = "content-length";
-const std::string HttpRequest::HEADER_ETAG_KEY = "if-none-match";
-const std::string HttpRequest::HEADER_CONTENT_TYPE_KEY = "content-type";
+const std::string HttpRequest::CHUNKED_ENCODING = "chunked";
+const size_t HttpRequest::MAX_CHUNK_SIZE = static_cast<size_t>(-1) >> 1;
 
-HttpRequest::HttpRequest() : logger("HTTP_REQUEST"), rawData(""), method(INVALID), uri(""), queryParameters(""), version(""), headers(), cookies(), body(""), contentLength(0), complete(false) {}
+const CharTable HttpRequest::URI_TABLE(URI_CHARACTERS);
+const CharTable HttpRequest::HEADER_VALUE_TABLE(HEADER_VALUE_CHARACTERS);
+const CharTable HttpRequest::HEADER_KEY_TABLE(HEADER_KEY_CHARACTERS);
+const CharTable HttpRequest::URI_DELIMITERS(" \r\n");
+const CharTable HttpRequest::HEADER_KEY_DELIMITERS(":\r\n");
+const CharTable HttpRequest::LINE_DELIMITERS("\r");
+
+HttpRequest::HttpRequest() : logger("HTTP_REQUEST"), rawData(""), parseState(PARSE_METHOD), parsePos(0), tokenStart(0), keyEnd(0), method(INVALID), uri(""), queryParameters(""), version(""), headers(), cookies(), body(""), contentLength(0), bodyReceived(0), chunked(false), chunkState(CHUNK_SIZE), chunkRemaining(0), chunkHasDigits(false), bodyAccepted(false), bodySink(NULL), complete(false) {}
 
 HttpRequest::HttpRequest(const HttpRequest &copy) {
     *this = copy;
@@ -30,6 +37,10 @@ HttpRequest &HttpRequest::operator=(const HttpRequest &assign) {
     if (this != &assign) {
         logger = assign.logger;
         rawData = assign.rawData;
+        parseState = assign.parseState;
+        parsePos = assign.parsePos;
+        tokenStart = assign.tokenStart;
+        keyEnd = assign.keyEnd;
         method = assign.method;
         uri = assign.uri;
         queryParameters = assign.queryParameters;
@@ -38,12 +49,26 @@ HttpRequest &HttpRequest::operator=(const HttpRequest &assign) {
         cookies = assign.cookies;
         body = assign.body;
         contentLength = assign.contentLength;
+        bodyReceived = assign.bodyReceived;
+        chunked = assign.chunked;
+        chunkState = assign.chunkState;
+        chunkRemaining = assign.chunkRemaining;
+        chunkHasDigits = assign.chunkHasDigits;
+        bodyAccepted = assign.bodyAccepted;
+        // The sink belongs to the owner of the original request
+        bodySink = NULL;
         complete = assign.complete;
     }
     return (*this);
 }
 
+// Drops the bytes of the finished request, anything pipelined after it stays buffered
 void HttpRequest::clear() {
+    rawData.erase(0, parsePos);
+    parseState = PARSE_METHOD;
+    parsePos = 0;
+    tokenStart = 0;
+    keyEnd = 0;
     method = INVALID;
     uri.clear();
     queryParameters.clear();
@@ -52,99 +77,390 @@ void HttpRequest::clear() {
     cookies.clear();
     body.clear();
     contentLength = 0;
+    bodyReceived = 0;
+    chunked = false;
+    chunkState = CHUNK_SIZE;
+    chunkRemaining = 0;
+    chunkHasDigits = false;
+    bodyAccepted = false;
+    bodySink = NULL;
     complete = false;
 }
 
+// Forgets the request and whatever was buffered behind it
+void HttpRequest::discard() {
+    rawData.clear();
+    parsePos = 0;
+    clear();
+}
+
 bool HttpRequest::digestRequest(const std::string &data) {
     rawData += data;
 
     try {
-        if (version.empty() && uri.empty() && method == INVALID) {
-            parseFristLine();
-        }
-
-        size_t pos = rawData.find("\r\n\r\n");
-        if (pos != std::string::npos) {
-            parseHeaders(pos);
-
-            if (headers.find(HEADER_HOST_KEY) == headers.end()) {
-                throw std::runtime_error("Host header not found");
-            }
-
-            std::map<std::string, std::string>::iterator it = headers.find(HEADER_COOKIES_KEY);
-            if (it != headers.end()) {
-                parseCookies(it->second);
-            }
-
-            if (contentLength == 0) {
-                complete = true;
-            }
-        }
-
-        if (contentLength > 0 && rawData.size() >= contentLength) {
-            body = rawData.substr(0, contentLength);
-            rawData = rawData.substr(contentLength);
-            complete = true;
-        }
-
+        parse();
         return (true);
     } catch (std::exception &e) {
         logger.error() << "Error: " << e.what() << std::endl;
-        rawData.clear();
-        clear();
+        discard();
         return (false);
     }
 }
 
-void HttpRequest::parseFristLine() {
-    size_t pos = rawData.find("\r\n");
-    if (pos == std::string::npos) {
-        return;
+// Resumes where the previous chunk stopped, every byte is looked at once and
+// only the parts handlers use are copied out of the buffer
+void HttpRequest::parse() {
+    while (parsePos < rawData.size() && parseState != PARSE_DONE) {
+        char c = rawData[parsePos];
+
+        switch (parseState) {
+            case PARSE_METHOD:
+                if ((c == '\r' || c == '\n') && parsePos == tokenStart) {
+                    // Empty lines before a request line are ignored
+                    tokenStart = parsePos + 1;
+                } else if (c == ' ') {
+                    parseMethod(tokenStart, parsePos);
+                    tokenStart = parsePos + 1;
+                    parseState = PARSE_URI;
+                } else if (c == '\r' || c == '\n') {
+                    throw std::runtime_error("Not found URI");
+                }
+                break;
+            case PARSE_URI:
+                parsePos = URI_DELIMITERS.find(rawData, parsePos);
+                if (parsePos == std::string::npos) {
+                    parsePos = rawData.size();
+                    return;
+                }
+                c = rawData[parsePos];
+                if (c == ' ') {
+                    parseUri(tokenStart, parsePos);
+                    tokenStart = parsePos + 1;
+                    parseState = PARSE_VERSION;
+                } else if (c == '\r' || c == '\n') {
+                    throw std::runtime_error("Not found version");
+                }
+                break;
+            case PARSE_VERSION:
+                if (c == '\r') {
+                    parseVersion(tokenStart, parsePos);
+                    parseState = PARSE_REQUEST_LINE_END;
+                } else if (c == ' ') {
+                    throw std::runtime_error("Extra parameters in first line");
+                }
+                break;
+            case PARSE_REQUEST_LINE_END:
+            case PARSE_HEADER_LINE_END:
+                if (c != '\n') {
+                    throw std::runtime_error("Invalid line ending");
+                }
+                parseState = PARSE_HEADER_START;
+                break;
+            case PARSE_HEADER_START:
+                if (c == '\r') {
+                    parseState = PARSE_HEADERS_END;
+                    break;
+                }
+                tokenStart = parsePos;
+                parseState = PARSE_HEADER_KEY;
+                continue;
+            case PARSE_HEADER_KEY:
+                parsePos = HEADER_KEY_DELIMITERS.find(rawData, parsePos);
+                if (parsePos == std::string::npos) {
+                    parsePos = rawData.size();
+                    return;
+                }
+                c = rawData[parsePos];
+                if (c == ':') {
+                    keyEnd = parsePos;
+                    parseState = PARSE_HEADER_VALUE;
+                } else if (c == '\r' || c == '\n') {
+                    throw std::runtime_error("Invalid header '" + rawData.substr(tokenStart, parsePos - tokenStart) + '\'');
+                }
+                break;
+            case PARSE_HEADER_VALUE:
+                parsePos = LINE_DELIMITERS.find(rawData, parsePos);
+                if (parsePos == std::string::npos) {
+                    parsePos = rawData.size();
+                    return;
+                }
+                parseHeader(tokenStart, keyEnd, parsePos);
+                parseState = PARSE_HEADER_LINE_END;
+                break;
+            case PARSE_HEADERS_END:
+                if (c != '\n') {
+                    throw std::runtime_error("Invalid line ending");
+                }
+                parsePos++;
+                tokenStart = parsePos;
+                finishHeaders();
+                continue;
+            case PARSE_BODY:
+                // The body waits until the client has decided where it goes
+                if (!bodyAccepted) {
+                    return;
+                }
+                if (chunked) {
+                    if (!consumeChunks()) {
+                        return;
+                    }
+                } else {
+                    consumeBody();
+                    if (bodyReceived < contentLength) {
+                        return;
+                    }
+                }
+                parseState = PARSE_DONE;
+                complete = true;
+                continue;
+            case PARSE_DONE:
+                break;
+        }
+        parsePos++;
     }
+}
 
-    std::string line = rawData.substr(0, pos);
-    rawData = rawData.substr(pos + 2);
+void HttpRequest::parseMethod(size_t start, size_t end) {
+    if (start == end) {
+        throw std::runtime_error("Not found method");
+    }
 
-    std::istringstream ss(line);
-    std::string stringMethod;
-    ss >> stringMethod;
-    ss >> uri;
-    ss >> version;
+    std::string stringMethod = rawData.substr(start, end - start);
+    method = getMethodFromString(stringMethod);
+    if (method == INVALID) {
+        throw std::runtime_error("Invalid method found '" + stringMethod + '\'');
+    }
+}
+
+void HttpRequest::parseUri(size_t start, size_t end) {
+    if (start == end) {
+        throw std::runtime_error("Not found URI");
+    }
+
+    uri.assign(rawData, start, end - start);
+    if (verifyUri(uri)) {
+        throw std::runtime_error("Invalid caracter in URI");
+    }
 
     size_t queryPos = uri.find('?');
     if (queryPos != std::string::npos) {
         queryParameters = uri.substr(queryPos + 1);
-        uri = uri.substr(0, queryPos);
+        uri.erase(queryPos);
     }
+}
 
-    if (stringMethod.empty()) {
-        throw std::runtime_error("Not found method");
+void HttpRequest::parseVersion(size_t start, size_t end) {
+    if (start == end) {
+        throw std::runtime_error("Not found version");
     }
-    if (uri.empty()) {
-        throw std::runtime_error("Not found URI");
+
+    version.assign(rawData, start, end - start);
+    if (version != HTTP_VERSION) {
+        throw std::runtime_error("Invalid HTTP version '" + version + '\'');
     }
-    if (version.empty()) {
-        throw std::runtime_error("Not found version");
+}
+
+// Only offsets are stored, key and value stay in the request buffer
+void HttpRequest::parseHeader(size_t start, size_t keyEnd, size_t end) {
+    const char *data = rawData.data();
+    if (HEADER_KEY_TABLE.findFirstNotOf(data + start, keyEnd - start) != std::string::npos) {
+        throw std::runtime_error("Invalid header key '" + rawData.substr(start, keyEnd - start) + '\'');
     }
 
-    std::string rest;
-    ss >> rest;
-    if (!rest.empty()) {
-        throw std::runtime_error("Extra parameters in first line");
+    size_t valueStart = keyEnd + 1;
+    while (valueStart < end && (data[valueStart] == ' ' || data[valueStart] == '\t')) {
+        ++valueStart;
+    }
+    while (end > valueStart && (data[end - 1] == ' ' || data[end - 1] == '\t')) {
+        --end;
+    }
+    if (HEADER_VALUE_TABLE.findFirstNotOf(data + valueStart, end - valueStart) != std::string::npos) {
+        throw std::runtime_error("Invalid header value '" + rawData.substr(valueStart, end - valueStart) + '\'');
     }
 
-    method = getMethodFromString(stringMethod);
-    if (method == INVALID) {
-        throw std::runtime_error("Invalid method found '" + stringMethod + '\'');
+    HeaderField field;
+    field.id = HeaderTable::intern(data + start, keyEnd - start);
+    // A later copy would replace the first, and a proxy that kept the first would frame the body differently
+    if ((field.id == HEADER_CONTENT_LENGTH || field.id == HEADER_HOST) && headers.find(field.id) != NULL) {
+        throw std::runtime_error("Duplicated header '" + rawData.substr(start, keyEnd - start) + '\'');
     }
+    field.keyStart = start;
+    field.keyLength = keyEnd - start;
+    field.valueStart = valueStart;
+    field.valueLength = end - valueStart;
+    headers.add(field);
+}
 
-    if (uri.find_first_not_of(URI_CHARACTERS) != std::string::npos) {
-        throw std::runtime_error("Invalid caracter in URI");
+void HttpRequest::finishHeaders() {
+    if (!hasHeader(HEADER_HOST)) {
+        throw std::runtime_error("Host header not found");
     }
 
-    if (version != HTTP_VERSION) {
-        throw std::runtime_error("Invalid HTTP version '" + version + '\'');
+    if (hasHeader(HEADER_COOKIE)) {
+        parseCookies(getHeader(HEADER_COOKIE));
+    }
+
+    if (hasHeader(HEADER_TRANSFER_ENCODING)) {
+        std::string value = getHeader(HEADER_TRANSFER_ENCODING);
+        lowercase(value);
+        if (value != CHUNKED_ENCODING) {
+            throw std::runtime_error("Unsupported Transfer-Encoding '" + value + '\'');
+        }
+        // Both framings at once would let a proxy and this server disagree on where the body ends
+        if (hasHeader(HEADER_CONTENT_LENGTH)) {
+            throw std::runtime_error("Content-Length sent with Transfer-Encoding");
+        }
+        chunked = true;
+    }
+
+    if (hasHeader(HEADER_CONTENT_LENGTH)) {
+        std::string value = getHeader(HEADER_CONTENT_LENGTH);
+        if (value.empty() || value.size() > 18 || value.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::runtime_error("Invalid Content-Length '" + value + '\'');
+        }
+        contentLength = std::strtol(value.c_str(), NULL, 10);
+    }
+
+    if (chunked || contentLength > 0) {
+        parseState = PARSE_BODY;
+    } else {
+        parseState = PARSE_DONE;
+        complete = true;
+    }
+}
+
+// Hands the body bytes read so far to the sink, or keeps them when there is none,
+// and drops them from the buffer so a large body is never held twice
+void HttpRequest::consumeBody() {
+    size_t available = std::min(rawData.size() - tokenStart, contentLength - bodyReceived);
+    if (available == 0) {
+        return;
+    }
+
+    deliverBody(tokenStart, available);
+    rawData.erase(tokenStart, available);
+    parsePos = tokenStart;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return (c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+        return (c - 'a' + 10);
+    } else if (c >= 'A' && c <= 'F') {
+        return (c - 'A' + 10);
     }
+    return (-1);
+}
+
+// Decodes as much of a chunked body as is buffered, chunk data goes to the sink straight
+// from the buffer and everything consumed, framing included, is dropped from it
+bool HttpRequest::consumeChunks() {
+    size_t pos = tokenStart;
+    bool done = false;
+
+    while (pos < rawData.size() && !done) {
+        char c = rawData[pos];
+
+        switch (chunkState) {
+            case CHUNK_SIZE:
+                if (hexValue(c) != -1) {
+                    if (chunkRemaining > (MAX_CHUNK_SIZE >> 4)) {
+                        throw std::runtime_error("Chunk size too large");
+                    }
+                    chunkRemaining = chunkRemaining * 16 + hexValue(c);
+                    chunkHasDigits = true;
+                } else if (!chunkHasDigits) {
+                    throw std::runtime_error("Invalid chunk size");
+                } else if (c == '\r') {
+                    chunkState = CHUNK_SIZE_END;
+                } else if (c == ';' || c == ' ' || c == '\t') {
+                    chunkState = CHUNK_EXTENSION;
+                } else {
+                    throw std::runtime_error("Invalid chunk size");
+                }
+                pos++;
+                break;
+            case CHUNK_EXTENSION:
+                // Extensions carry nothing this server uses
+                if (c == '\r') {
+                    chunkState = CHUNK_SIZE_END;
+                } else if (c == '\n') {
+                    throw std::runtime_error("Invalid chunk extension");
+                }
+                pos++;
+                break;
+            case CHUNK_SIZE_END:
+                if (c != '\n') {
+                    throw std::runtime_error("Invalid line ending");
+                }
+                chunkState = (chunkRemaining == 0) ? CHUNK_TRAILER_START : CHUNK_DATA;
+                pos++;
+                break;
+            case CHUNK_DATA: {
+                size_t available = std::min(rawData.size() - pos, chunkRemaining);
+                deliverBody(pos, available);
+                pos += available;
+                chunkRemaining -= available;
+                if (chunkRemaining == 0) {
+                    chunkState = CHUNK_DATA_END;
+                }
+                break;
+            }
+            case CHUNK_DATA_END:
+                if (c != '\r') {
+                    throw std::runtime_error("Chunk longer than its size");
+                }
+                chunkState = CHUNK_DATA_LF;
+                pos++;
+                break;
+            case CHUNK_DATA_LF:
+                if (c != '\n') {
+                    throw std::runtime_error("Invalid line ending");
+                }
+                chunkState = CHUNK_SIZE;
+                chunkHasDigits = false;
+                pos++;
+                break;
+            case CHUNK_TRAILER_START:
+                if (c == '\r') {
+                    chunkState = CHUNK_TRAILER_END;
+                } else if (c == '\n') {
+                    throw std::runtime_error("Invalid line ending");
+                } else {
+                    // Trailer fields are skipped, none of them affect how the request is served
+                    chunkState = CHUNK_TRAILER;
+                }
+                pos++;
+                break;
+            case CHUNK_TRAILER:
+                if (c == '\n') {
+                    chunkState = CHUNK_TRAILER_START;
+                }
+                pos++;
+                break;
+            case CHUNK_TRAILER_END:
+                if (c != '\n') {
+                    throw std::runtime_error("Invalid line ending");
+                }
+                done = true;
+                pos++;
+                break;
+        }
+    }
+
+    rawData.erase(tokenStart, pos - tokenStart);
+    parsePos = tokenStart;
+    return (done);
+}
+
+void HttpRequest::deliverBody(size_t start, size_t size) {
+    if (bodySink != NULL) {
+        bodySink->write(rawData.data() + start, size);
+    } else {
+        body.append(rawData, start, size);
+    }
+    bodyReceived += size;
 }
 
 void HttpRequest::parseCookies(const std::string &cookieHeader) {
@@ -165,51 +481,16 @@ const std::map<std::string, std::string> &HttpRequest::getCookies() const {
     return (cookies);
 }
 
-void HttpRequest::parseHeaders(size_t endPos) {
-    std::string data = rawData.substr(0, endPos + 2);
-    rawData = rawData.substr(endPos + 4);
-
-    size_t pos;
-    while ((pos = data.find("\r\n")) != std::string::npos) {
-        std::string line = data.substr(0, pos);
-        data = data.substr(pos + 2);
-
-        if ((pos = line.find(':')) == std::string::npos) {
-            throw std::runtime_error("Invalid header '" + line + '\'');
-        }
-
-        std::string key = line.substr(0, pos);
-        if (verifyHeaderKey(key)) {
-            throw std::runtime_error("Invalid header key '" + key + '\'');
-        }
-        lowercase(key);
-
-        std::string value = line.substr(pos + 1);
-        trim(value);
-        if (verifyHeaderValue(value)) {
-            throw std::runtime_error("Invalid header value '" + value + '\'');
-        }
-
-        headers[key] = value;
-    }
-
-    if (headers.find(CONTENT_LENTH_HEADER_KEY) != headers.end()) {
-        char *end;
-        long size = std::strtol(headers[CONTENT_LENTH_HEADER_KEY].c_str(), &end, 10);
-        // check se Content-Length é maior que body size because yeah
-        if (*end != '\0' || size < 0) {
-            throw std::runtime_error("Invalid Content-Length '" + headers[CONTENT_LENTH_HEADER_KEY] + '\'');
-        }
-        contentLength = size;
-    }
+bool HttpRequest::verifyUri(const std::string &uri) {
+    return (URI_TABLE.findFirstNotOf(uri) != std::string::npos);
 }
 
 bool HttpRequest::verifyHeaderKey(const std::string &key) {
-    return (key.find_first_not_of(HEADER_KEY_CHARACTERS) != std::string::npos);
+    return (HEADER_KEY_TABLE.findFirstNotOf(key) != std::string::npos);
 }
 
 bool HttpRequest::verifyHeaderValue(const std::string &value) {
-    return (value.find_first_not_of(HEADER_VALUE_CHARACTERS) != std::string::npos);
+    return (HEADER_VALUE_TABLE.findFirstNotOf(value) != std::string::npos);
 }
 
 Method HttpRequest::getMethod() const {
@@ -228,21 +509,142 @@ const std::string &HttpRequest::getVersion() const {
     return (version);
 }
 
-const std::map<std::string, std::string> &HttpRequest::getHeaders() const {
-    return (headers);
+bool HttpRequest::hasHeader(HeaderId id) const {
+    return (headers.find(id) != NULL);
+}
+
+std::string HttpRequest::getHeader(HeaderId id) const {
+    const HeaderField *field = headers.find(id);
+    if (field == NULL) {
+        return ("");
+    }
+    return (rawData.substr(field->valueStart, field->valueLength));
+}
+
+std::string HttpRequest::getHeader(const std::string &name) const {
+    const HeaderField *field = headers.find(rawData, name);
+    if (field == NULL) {
+        return ("");
+    }
+    return (rawData.substr(field->valueStart, field->valueLength));
+}
+
+size_t HttpRequest::getHeaderCount() const {
+    return (headers.size());
+}
+
+// Names come back lowercased, the way they were stored before the table
+std::string HttpRequest::getHeaderName(size_t index) const {
+    const HeaderField &field = headers.at(index);
+    std::string name = rawData.substr(field.keyStart, field.keyLength);
+    lowercase(name);
+    return (name);
+}
+
+std::string HttpRequest::getHeaderValue(size_t index) const {
+    const HeaderField &field = headers.at(index);
+    return (rawData.substr(field.valueStart, field.valueLength));
 }
 
 const std::string &HttpRequest::getBody() const {
     return (body);
 }
 
+size_t HttpRequest::getContentLength() const {
+    return (contentLength);
+}
+
+// Bytes of body received so far, the only size known ahead of a chunked body's end
+size_t HttpRequest::getBodySize() const {
+    return (bodyReceived);
+}
+
+bool HttpRequest::isChunked() const {
+    return (chunked);
+}
+
 bool HttpRequest::isComplete() const {
     return (complete);
 }
 
-std::string HttpRequest::getEtag() const {
-    if (headers.find(HEADER_ETAG_KEY) != headers.end()) {
-        return headers.at(HEADER_ETAG_KEY);
+bool HttpRequest::isEmpty() const {
+    return (parseState == PARSE_METHOD && tokenStart == rawData.size());
+}
+
+bool HttpRequest::hasHeaders() const {
+    return (parseState == PARSE_BODY || parseState == PARSE_DONE);
+}
+
+bool HttpRequest::isAwaitingBody() const {
+    return (parseState == PARSE_BODY && !bodyAccepted);
+}
+
+bool HttpRequest::isReadingBody() const {
+    return (parseState == PARSE_BODY && bodyAccepted);
+}
+
+// A NULL sink keeps the body in memory, for requests whose size was already checked
+void HttpRequest::acceptBody(BodySink *sink) {
+    bodyAccepted = true;
+    bodySink = sink;
+}
+
+Preconditions HttpRequest::getPreconditions() const {
+    return (Preconditions(getHeader(HEADER_IF_MATCH), getHeader(HEADER_IF_NONE_MATCH), getHeader(HEADER_IF_MODIFIED_SINCE), getHeader(HEADER_IF_UNMODIFIED_SINCE)));
+}
+
+// A coding is accepted when listed, or matched by "*", with a non-zero quality
+bool HttpRequest::acceptsEncoding(const std::string &coding) const {
+    if (!hasHeader(HEADER_ACCEPT_ENCODING)) {
+        return (false);
+    }
+
+    std::string value = getHeader(HEADER_ACCEPT_ENCODING);
+    lowercase(value);
+    std::vector<std::string> codings;
+    split(value, ',', codings);
+    bool accepted = false;
+    for (std::vector<std::string>::iterator it = codings.begin(); it != codings.end(); ++it) {
+        size_t semicolon = (*it).find(';');
+        std::string name = (*it).substr(0, semicolon);
+        trim(name);
+        if (name != coding && name != "*") {
+            continue;
+        }
+
+        bool refused = false;
+        if (semicolon != std::string::npos) {
+            std::string parameter = (*it).substr(semicolon + 1);
+            trim(parameter);
+            refused = parameter.compare(0, 2, "q=") == 0 && std::strtod(parameter.c_str() + 2, NULL) <= 0;
+        }
+        // An explicit entry for the coding overrides the wildcard
+        if (name == coding) {
+            return (!refused);
+        }
+        accepted = !refused;
+    }
+    return (accepted);
+}
+
+// HTTP/1.1 connections are persistent unless the client lists "close" in the Connection header
+bool HttpRequest::isKeepAlive() const {
+    if (!hasHeader(HEADER_CONNECTION)) {
+        return (version == HTTP_VERSION);
+    }
+
+    std::string value = getHeader(HEADER_CONNECTION);
+    lowercase(value);
+    std::vector<std::string> options;
+    split(value, ',', options);
+    bool keepAlive = (version == HTTP_VERSION);
+    for (std::vector<std::string>::iterator option = options.begin(); option != options.end(); ++option) {
+        trim(*option);
+        if (*option == "close") {
+            return (false);
+        } else if (*option == "keep-alive") {
+            keepAlive = true;
+        }
     }
-    return "";
+    return (keepAlive);
 }
@@ -1,23 +1,29 @@
 #include "HttpResponse.hpp"
 
-#include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <cctype>
 #include <cstdio>
 #include <ctime>
-#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 
+#include "AutoindexCache.hpp"
+#include "FileCache.hpp"
+#include "OutputQueue.hpp"
 #include "utils.h"
 
 const std::string HttpResponse::SERVER_NAME = "Webserver/1.0";
 const std::string HttpResponse::HTTP_VERSION = "HTTP/1.1";
 const std::string HttpResponse::DEFAULT_MIME_TYPE = "text/plain";
+const size_t HttpResponse::MAX_RANGES = 16;
 
-HttpResponse::HttpResponse() : httpStatus(0), contentType(""), body(""), lastModified(""), fileName(""), etag(""), hasZeroContentLength(false), extraHeaders(), cookies() {}
+HttpResponse::HttpResponse() : httpStatus(0), contentType(""), body(""), page(NULL), lastModified(""), fileName(""), etag(""), contentEncoding(""), vary(false), compression(), acceptsGzip(false), cachePolicy(), hasZeroContentLength(false), hasFileBody(false), chunked(false), fileFd(-1), cachedBody(), fileOffset(0), fileSize(0), range(), ifRange(), ranges(), partHeaders(), extraHeaders(), cookies() {}
 
 HttpResponse::~HttpResponse() {}
 
@@ -30,11 +36,29 @@ HttpResponse &HttpResponse::operator=(const HttpResponse &assign) {
         httpStatus = assign.httpStatus;
         contentType = assign.contentType;
         body = assign.body;
+        page = assign.page;
         lastModified = assign.lastModified;
         fileName = assign.fileName;
         etag = assign.etag;
         location = assign.location;
+        connection = assign.connection;
+        keepAlive = assign.keepAlive;
+        contentEncoding = assign.contentEncoding;
+        vary = assign.vary;
+        compression = assign.compression;
+        acceptsGzip = assign.acceptsGzip;
+        cachePolicy = assign.cachePolicy;
         hasZeroContentLength = assign.hasZeroContentLength;
+        hasFileBody = assign.hasFileBody;
+        chunked = assign.chunked;
+        fileFd = -1;
+        cachedBody = assign.cachedBody;
+        fileOffset = assign.fileOffset;
+        fileSize = assign.fileSize;
+        range = assign.range;
+        ifRange = assign.ifRange;
+        ranges = assign.ranges;
+        partHeaders = assign.partHeaders;
         extraHeaders = assign.extraHeaders;
         cookies = assign.cookies;
     }
@@ -42,14 +66,17 @@ HttpResponse &HttpResponse::operator=(const HttpResponse &assign) {
     return *this;
 }
 
-std::string HttpResponse::createResponse() {
+void HttpResponse::createResponse(OutputQueue &output) {
     std::ostringstream serverResponse;
 
-    if (httpStatus >= 400 && httpStatus <= 500 && body.empty()) {
-        generateDefaultErrorPage();
+    // Every error carries a body, a keep-alive client needs its Content-Length to find the next response
+    if (httpStatus >= 400 && body.empty() && page == NULL) {
+        page = &getDefaultErrorPage(httpStatus);
+        contentType = "text/html";
     }
+    const std::string &content = compressBody();
 
-    serverResponse << HTTP_VERSION << ' ' << httpStatus << ' ' << getStatusMessage() << "\r\n";
+    serverResponse << HTTP_VERSION << ' ' << httpStatus << ' ' << getStatusMessage(httpStatus) << "\r\n";
     serverResponse << "Server: " << SERVER_NAME << "\r\n";
     serverResponse << "Date: " << createDate() << "\r\n";
 
@@ -62,14 +89,24 @@ std::string HttpResponse::createResponse() {
         }
     }
 
-    if ((!body.empty() || hasZeroContentLength) && extraHeaders.find("Content-Length") == extraHeaders.end())
-        serverResponse << "Content-Length: " << (hasZeroContentLength ? 0 : body.size()) << "\r\n";
+    if (chunked)
+        serverResponse << "Transfer-Encoding: chunked\r\n";
+    else if (hasFileBody)
+        serverResponse << "Content-Length: " << fileSize << "\r\n";
+    else if ((!content.empty() || hasZeroContentLength) && extraHeaders.find("Content-Length") == extraHeaders.end())
+        serverResponse << "Content-Length: " << (hasZeroContentLength ? 0 : content.size()) << "\r\n";
 
     if (!lastModified.empty())
         serverResponse << "Last-Modified: " << lastModified << "\r\n";
 
     if (!fileName.empty())
-        serverResponse << "Content-Type: " << setContentTypeFromFilename() << "\r\n";
+        serverResponse << "Content-Type: " << getFileMimeType() << "\r\n";
+
+    if (!contentEncoding.empty())
+        serverResponse << "Content-Encoding: " << contentEncoding << "\r\n";
+
+    if (vary)
+        serverResponse << "Vary: Accept-Encoding\r\n";
 
     if (!location.empty())
         serverResponse << "Location: " << location << "\r\n";
@@ -77,6 +114,12 @@ std::string HttpResponse::createResponse() {
     if (!etag.empty())
         serverResponse << "ETag: " << etag << "\r\n";
 
+    if (!connection.empty())
+        serverResponse << "Connection: " << connection << "\r\n";
+
+    if (!keepAlive.empty())
+        serverResponse << "Keep-Alive: " << keepAlive << "\r\n";
+
     if (!cookies.empty()) {
         for (std::vector<std::string>::const_iterator cookie = cookies.begin(); cookie != cookies.end(); ++cookie) {
             serverResponse << "Set-Cookie: " << *cookie << "\r\n";
@@ -85,33 +128,269 @@ std::string HttpResponse::createResponse() {
 
     serverResponse << "\r\n";
 
-    if (!body.empty()) {
-        serverResponse << body;
+    // Header, body and file go out as separate segments gathered by a single writev
+    std::string header = serverResponse.str();
+    output.push(header);
+    if (ranges.size() > 1) {
+        pushRanges(output);
+        return;
     }
-
-    return serverResponse.str();
+    if (&content == &body) {
+        output.push(body);
+    } else {
+        output.pushShared(content);
+    }
+    if (fileFd != -1) {
+        output.pushFile(fileFd, fileOffset, fileSize);
+        fileFd = -1;
+    }
+    output.pushShared(cachedBody, fileOffset, cachedBody.empty() ? 0 : fileSize);
 }
 
-std::string HttpResponse::createResponseFromLocation(size_t status, const std::string &location) {
+void HttpResponse::createResponseFromLocation(OutputQueue &output, size_t status, const std::string &location) {
     httpStatus = status;
     this->location = location;
     this->hasZeroContentLength = true;
-    std::string responseString = createResponse();
+    createResponse(output);
     clear();
-    return (responseString);
 }
 
 void HttpResponse::clear() {
     httpStatus = 0;
     contentType.clear();
     body.clear();
+    page = NULL;
     lastModified.clear();
     fileName.clear();
     etag.clear();
     location.clear();
+    connection.clear();
+    keepAlive.clear();
+    contentEncoding.clear();
+    vary = false;
+    compression = Compression();
+    acceptsGzip = false;
+    cachePolicy = CachePolicy();
     extraHeaders.clear();
     cookies.clear();
     hasZeroContentLength = false;
+    hasFileBody = false;
+    chunked = false;
+    if (fileFd != -1) {
+        close(fileFd);
+        fileFd = -1;
+    }
+    cachedBody = SharedBuffer();
+    fileOffset = 0;
+    fileSize = 0;
+    range.clear();
+    ifRange.clear();
+    ranges.clear();
+    partHeaders.clear();
+}
+
+void HttpResponse::setConnection(bool keepAlive, size_t timeout, size_t maxRequests) {
+    if (!keepAlive) {
+        connection = "close";
+        this->keepAlive.clear();
+        return;
+    }
+    connection = "keep-alive";
+    this->keepAlive = "timeout=" + numberToString(timeout) + ", max=" + numberToString(maxRequests);
+}
+
+void HttpResponse::setCompression(const Compression &compression, bool acceptsGzip) {
+    this->compression = compression;
+    this->acceptsGzip = acceptsGzip;
+}
+
+void HttpResponse::setEncoding(const std::string &encoding) {
+    contentEncoding = encoding;
+}
+
+void HttpResponse::setCachePolicy(const CachePolicy &cachePolicy) {
+    this->cachePolicy = cachePolicy;
+}
+
+// Generated pages are compressed here, files arrive already compressed from the cache or their .gz sibling.
+// Returns what is sent as the body, either body itself or a form of the page
+const std::string &HttpResponse::compressBody() {
+    const std::string &content = (page != NULL && body.empty()) ? page->content : body;
+    std::string mimeType = contentType.empty() ? getFileMimeType() : contentType;
+    if ((compression.isEnabled() && Compression::isCompressible(mimeType)) || (compression.isStaticEnabled() && hasFileBody)) {
+        vary = true;
+    }
+    if (!acceptsGzip || !contentEncoding.empty() || hasFileBody || chunked || !compression.shouldCompress(mimeType, content.size())) {
+        return (content);
+    }
+
+    // A generated page keeps its gzip form, only other bodies are compressed for each response
+    if (page != NULL) {
+        const std::string *gzip = compression.getGzip(*page);
+        if (gzip == NULL) {
+            return (content);
+        }
+        contentEncoding = "gzip";
+        if (&content == &body) {
+            body = *gzip;
+            return (body);
+        }
+        return (*gzip);
+    }
+
+    std::string compressed;
+    if (gzipCompress(body, compression.getLevel(), compressed) && compressed.size() < body.size()) {
+        body.swap(compressed);
+        contentEncoding = "gzip";
+    }
+    return (body);
+}
+
+void HttpResponse::setRange(const std::string &range, const std::string &ifRange) {
+    this->range = range;
+    this->ifRange = ifRange;
+}
+
+// If-Range holds the ETag or the Last-Modified date of the copy the client has a part of
+bool HttpResponse::matchesIfRange() const {
+    if (ifRange.empty()) {
+        return (true);
+    }
+    if (ifRange[0] == '"' || ifRange.compare(0, 2, "W/") == 0) {
+        // A weak tag never matches, the parts could come from different contents
+        return (ifRange == etag);
+    }
+    return (ifRange == lastModified);
+}
+
+static bool parseOffset(const std::string &text, off_t &value) {
+    if (text.empty() || text.size() > 18) {
+        return (false);
+    }
+    value = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(text[i]))) {
+            return (false);
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return (true);
+}
+
+// Keeps the satisfiable ranges clamped to the size, false when the header is malformed and must be ignored
+bool HttpResponse::parseRanges(off_t size) {
+    ranges.clear();
+    if (range.compare(0, 6, "bytes=") != 0) {
+        return (false);
+    }
+
+    std::vector<std::string> specs;
+    split(range.substr(6), ',', specs);
+    if (specs.empty() || specs.size() > MAX_RANGES) {
+        return (false);
+    }
+    for (std::vector<std::string>::iterator spec = specs.begin(); spec != specs.end(); ++spec) {
+        trim(*spec);
+        size_t dash = spec->find('-');
+        if (dash == std::string::npos) {
+            return (false);
+        }
+
+        off_t first;
+        off_t last;
+        if (dash == 0) {
+            // A suffix range asks for the last bytes of the file
+            if (!parseOffset(spec->substr(1), last)) {
+                return (false);
+            }
+            if (last > 0 && size > 0) {
+                ranges.push_back(std::make_pair(std::max(size - last, static_cast<off_t>(0)), size - 1));
+            }
+            continue;
+        }
+        if (!parseOffset(spec->substr(0, dash), first)) {
+            return (false);
+        }
+        if (dash + 1 == spec->size()) {
+            last = size - 1;
+        } else if (!parseOffset(spec->substr(dash + 1), last) || last < first) {
+            return (false);
+        }
+        if (first < size) {
+            ranges.push_back(std::make_pair(first, std::min(last, size - 1)));
+        }
+    }
+    return (true);
+}
+
+// Called once the full body is set, turns the response into a 206 or 416 when the Range header applies
+void HttpResponse::selectRanges() {
+    extraHeaders["Accept-Ranges"] = "bytes";
+    if (range.empty() || !matchesIfRange() || !parseRanges(fileSize)) {
+        ranges.clear();
+        return;
+    }
+
+    off_t size = fileSize;
+    if (ranges.empty()) {
+        httpStatus = 416;
+        extraHeaders["Content-Range"] = "bytes */" + numberToString(size);
+        contentType.clear();
+        contentEncoding.clear();
+        fileName.clear();
+        body.clear();
+        cachedBody = SharedBuffer();
+        hasFileBody = false;
+        if (fileFd != -1) {
+            close(fileFd);
+            fileFd = -1;
+        }
+        fileSize = 0;
+        return;
+    }
+
+    httpStatus = 206;
+    if (ranges.size() == 1) {
+        off_t first = ranges[0].first;
+        off_t last = ranges[0].second;
+        extraHeaders["Content-Range"] = "bytes " + numberToString(first) + '-' + numberToString(last) + '/' + numberToString(size);
+        fileOffset = first;
+        fileSize = last - first + 1;
+        ranges.clear();
+        return;
+    }
+
+    // Made of digits only, so it can't be confused with the headers of a part
+    static unsigned int boundaryCount = 0;
+    std::ostringstream boundary;
+    boundary << std::setfill('0') << std::setw(20) << getCurrentTimeMillis() * 1000 + ++boundaryCount % 1000;
+    std::string partType = contentType.empty() ? getFileMimeType() : contentType;
+    contentType = "multipart/byteranges; boundary=" + boundary.str();
+    fileName.clear();
+    fileSize = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        std::string partHeader = "\r\n--" + boundary.str() + "\r\nContent-Type: " + partType + "\r\nContent-Range: bytes " + numberToString(ranges[i].first) + '-' + numberToString(ranges[i].second) + '/' + numberToString(size) + "\r\n\r\n";
+        fileSize += partHeader.size() + ranges[i].second - ranges[i].first + 1;
+        partHeaders.push_back(partHeader);
+    }
+    partHeaders.push_back("\r\n--" + boundary.str() + "--\r\n");
+    fileSize += partHeaders.back().size();
+}
+
+// Every part reads its own region of the file, which is closed with the last one
+void HttpResponse::pushRanges(OutputQueue &output) {
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        off_t length = ranges[i].second - ranges[i].first + 1;
+        if (fileFd == -1) {
+            output.push(partHeaders[i]);
+            output.pushShared(cachedBody, ranges[i].first, length);
+        } else {
+            output.push(partHeaders[i]);
+            output.pushFile(fileFd, ranges[i].first, length, i + 1 == ranges.size());
+        }
+    }
+    output.push(partHeaders.back());
+    fileFd = -1;
 }
 
 void HttpResponse::setCookie(const std::string &key, const std::string &value, const std::string &expires, const std::string &path = "/", bool httpOnly = false) {
@@ -130,23 +409,28 @@ std::string HttpResponse::createDate() {
     return buffer;
 }
 
-void HttpResponse::generateDefaultErrorPage() {
-    std::ostringstream errorPage;
+// Rendered once per status, every error without a page of its own shares it
+const GeneratedPage &HttpResponse::getDefaultErrorPage(size_t status) {
+    static std::map<size_t, GeneratedPage> pages;
 
-    errorPage << "<html>\n";
-    errorPage << "<head><title>" << httpStatus << ' ' << getStatusMessage() << "</title></head>\n";
-    errorPage << "<body>\n";
-    errorPage << "<center><h1>" << httpStatus << ' ' << getStatusMessage() << "</h1></center>\n";
-    errorPage << "<hr><center>" << SERVER_NAME << "</center>\n";
-    errorPage << "</body>\n";
-    errorPage << "</html>\n";
-
-    body = errorPage.str();
-    contentType = "text/html";
+    std::map<size_t, GeneratedPage>::iterator found = pages.find(status);
+    if (found != pages.end()) {
+        return (found->second);
+    }
+    std::string title = numberToString(status) + ' ' + getStatusMessage(status);
+    std::string &page = pages[status].content;
+    page = "<html>\n";
+    page += "<head><title>" + title + "</title></head>\n";
+    page += "<body>\n";
+    page += "<center><h1>" + title + "</h1></center>\n";
+    page += "<hr><center>" + SERVER_NAME + "</center>\n";
+    page += "</body>\n";
+    page += "</html>\n";
+    return (pages[status]);
 }
 
-std::string HttpResponse::getStatusMessage() {
-    switch (httpStatus) {
+std::string HttpResponse::getStatusMessage(size_t status) {
+    switch (status) {
         case 200:
             return "OK";
         case 201:
@@ -187,6 +471,8 @@ std::string HttpResponse::getStatusMessage() {
             return "Gone";
         case 411:
             return "Length Required";
+        case 412:
+            return "Precondition Failed";
         case 413:
             return "Payload Too Large";
         case 414:
@@ -214,7 +500,7 @@ std::string HttpResponse::getStatusMessage() {
     }
 }
 
-std::string HttpResponse::setContentTypeFromFilename() {
+std::string HttpResponse::getMimeType(const std::string &fileName) {
     static const std::pair<const char *, const char *> mimeTypesArray[] = {
         std::make_pair("html", "text/html"),
         std::make_pair("htm", "text/html"),
@@ -251,143 +537,167 @@ std::string HttpResponse::setContentTypeFromFilename() {
     return (mimeType);
 }
 
-std::string getFileModificationDate(const struct stat &fileInfo, bool gmt) {
-    std::time_t modTime = fileInfo.st_mtime;
-    struct tm *gmtTime = std::gmtime(&modTime);
-    char timeString[80];
-    std::strftime(timeString, sizeof(timeString), gmt ? "%a, %d %b %Y %H:%M:%S GMT" : "%a, %d %b %Y %H:%M:%S", gmtTime);
-    return timeString;
-}
-
-void HttpResponse::createAutoindex(const std::string &directoryPath, const std::string &uri) {
-    DIR *dir = opendir(directoryPath.c_str());
-    if (dir == NULL) {
-        httpStatus = 404;
-        return;
+// A gzip encoded .gz file is described by the type of what it decompresses to
+std::string HttpResponse::getFileMimeType() const {
+    if (fileName.empty()) {
+        return ("");
     }
-    std::ostringstream indexPage;
-    struct dirent *dent;
-
-    indexPage << "<html>\n";
-    indexPage << "<head><title> Index of " << uri << "</title></head>\n";
-    indexPage << "<body><h1>Index of " << uri << "</h1><hr><pre>\n";
-    indexPage << "<a href='../'>../</a>\n";
-
-    while ((dent = readdir(dir)) != NULL) {
-        std::string strName = dent->d_name;
-        if (strName[0] == '.') {
-            continue;
-        }
-
-        indexPage << "<a href='" << strName + ((dent->d_type == DT_DIR) ? "/" : "") << "'>" << std::setw(50) << std::left << strName + "</a>";
-
-        struct stat fileInfo;
-        if (stat((directoryPath + '/' + strName).c_str(), &fileInfo) != 0) {
-            httpStatus = 500;
-            closedir(dir);
-            return;
-        }
-
-        std::string date = getFileModificationDate(fileInfo, false);
-        if (date.empty()) {
-            httpStatus = 500;
-            closedir(dir);
-            return;
-        }
-        indexPage << date;
-
-        if (dent->d_type == DT_DIR)
-            indexPage << std::setw(30) << std::right << '-' << std::endl;
-        else
-            indexPage << std::setw(30) << std::right << fileInfo.st_size << std::endl;
+    if (contentEncoding == "gzip" && fileName.size() > 3 && fileName.compare(fileName.size() - 3, 3, ".gz") == 0) {
+        return (getMimeType(fileName.substr(0, fileName.size() - 3)));
     }
-    closedir(dir);
-    indexPage << "</pre><hr></body></html>";
-
-    httpStatus = 200;
-    fileName = "index.html";
-    body = indexPage.str();
+    return (getMimeType(fileName));
 }
 
-std::string HttpResponse::createResponseFromStatus(size_t status) {
+void HttpResponse::createResponseFromStatus(OutputQueue &output, size_t status) {
     httpStatus = status;
-    std::string responseString = createResponse();
+    createResponse(output);
     clear();
-    return (responseString);
 }
 
-std::string HttpResponse::createCgiResponse(size_t status, const std::string &body, const std::map<std::string, std::string> &headers, const std::vector<std::string> &cookies) {
+// Only the head goes out, the body follows as it is produced, in chunks unless the headers carry its length
+void HttpResponse::createStreamResponse(OutputQueue &output, size_t status, const std::map<std::string, std::string> &headers, const std::vector<std::string> &cookies, bool chunked) {
     httpStatus = status;
-    this->body = body;
-    hasZeroContentLength = body.empty();
+    this->chunked = chunked;
     extraHeaders = headers;
     this->cookies = cookies;
-    std::string responseString = createResponse();
+    createResponse(output);
     clear();
-    return (responseString);
 }
 
-std::string HttpResponse::createErrorResponse(size_t status, const std::string &root, const std::vector<std::pair<size_t, std::string> > &errorPages) {
+// Takes the content of data like OutputQueue::push, an empty chunk would end the body so it is skipped
+void HttpResponse::pushChunk(OutputQueue &output, std::string &data) {
+    if (data.empty()) {
+        return;
+    }
+
+    std::ostringstream size;
+    size << std::hex << data.size() << "\r\n";
+    std::string chunkHeader = size.str();
+    std::string chunkEnd = "\r\n";
+    output.push(chunkHeader);
+    output.push(data);
+    output.push(chunkEnd);
+}
+
+void HttpResponse::pushLastChunk(OutputQueue &output) {
+    std::string lastChunk = "0\r\n\r\n";
+    output.push(lastChunk);
+}
+
+void HttpResponse::createErrorResponse(OutputQueue &output, size_t status, const std::map<size_t, GeneratedPage> &errorPages) {
     httpStatus = status;
-    for (std::vector<std::pair<size_t, std::string> >::const_iterator it = errorPages.begin(); it != errorPages.end(); ++it) {
-        if (it->first == status) {
-            std::string filePath = createPath(root, it->second);
-            std::ifstream file(filePath.c_str());
-            if (file.is_open()) {
-                std::stringstream buffer;
-                buffer << file.rdbuf();
-                body = buffer.str();
-                file.close();
-            }
-        }
+    // The encoding chosen for a .gz sibling doesn't apply to the page sent in its place
+    contentEncoding.clear();
+    // The page lives as long as the configuration, it is sent without being copied
+    body.clear();
+    std::map<size_t, GeneratedPage>::const_iterator found = errorPages.find(status);
+    if (found != errorPages.end()) {
+        page = &found->second;
     }
 
-    std::string responseString = createResponse();
+    createResponse(output);
     clear();
-    return (responseString);
 }
 
-std::string HttpResponse::createIndexResponse(const std::string &directoryPath, const std::string &uri, const std::string &root, const std::vector<std::pair<size_t, std::string> > &errorPages) {
-    createAutoindex(directoryPath, uri);
-    if (httpStatus >= 400 && httpStatus <= 599) {
-        return (createErrorResponse(httpStatus, root, errorPages));
+void HttpResponse::createIndexResponse(OutputQueue &output, const std::string &directoryPath, const std::string &uri, const std::string &query, AutoindexCache &cache, const std::map<size_t, GeneratedPage> &errorPages) {
+    bool json;
+    page = cache.getPage(directoryPath, uri, query, json);
+    if (page == NULL) {
+        createErrorResponse(output, 404, errorPages);
+        return;
     }
-    std::string responseString = createResponse();
+
+    // A listing can be rebuilt while a slow client is still reading the page, so it goes out from a copy
+    httpStatus = 200;
+    contentType = json ? "application/json" : "text/html";
+    body = page->content;
+    createResponse(output);
     clear();
-    return (responseString);
 }
 
-void HttpResponse::generateEtag(const struct stat &fileInfo) {
+std::string HttpResponse::generateEtag(const struct stat &fileInfo) {
     std::ostringstream etagStream;
     etagStream << std::hex << '"' << fileInfo.st_mtime << '-' << fileInfo.st_size << '"';
-    etag = etagStream.str();
+    return (etagStream.str());
+}
+
+std::string HttpResponse::getLastModified(const struct stat &fileInfo) {
+    return (formatHttpDate(fileInfo.st_mtime));
 }
 
-std::string HttpResponse::createFileResponse(const std::string &filePath, const std::string &etag, const std::string &root, const std::vector<std::pair<size_t, std::string> > &errorPages) {
-    std::ifstream file(filePath.c_str());
-    if (!file.is_open()) {
-        return (createErrorResponse(404, root, errorPages));
+// The preconditions are decided from the metadata alone, a 304 or 412 never reads the file
+void HttpResponse::createFileResponse(OutputQueue &output, const std::string &filePath, const Preconditions &preconditions, const std::map<size_t, GeneratedPage> &errorPages) {
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd == -1) {
+        createErrorResponse(output, 404, errorPages);
+        return;
+    }
+
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0) {
+        close(fd);
+        createErrorResponse(output, 500, errorPages);
+        return;
+    }
+
+    std::string fileEtag = generateEtag(fileInfo);
+    Preconditions::Result result = preconditions.evaluate(fileEtag, fileInfo.st_mtime, true, true);
+    if (result == Preconditions::PRECONDITION_FAILED) {
+        close(fd);
+        createErrorResponse(output, 412, errorPages);
+        return;
+    }
+
+    lastModified = getLastModified(fileInfo);
+    etag = fileEtag;
+    cachePolicy.addHeaders(extraHeaders);
+    if (result == Preconditions::PRECONDITION_NOT_MODIFIED) {
+        httpStatus = 304;
+        close(fd);
     } else {
-        struct stat fileInfo;
-        if (stat(filePath.c_str(), &fileInfo) != 0) {
-            return (createErrorResponse(500, root, errorPages));
+        this->fileName = filePath;
+        httpStatus = 200;
+        hasFileBody = true;
+        fileSize = fileInfo.st_size;
+        if (fileSize > 0) {
+            fileFd = fd;
         } else {
-            lastModified = getFileModificationDate(fileInfo, true);
-            generateEtag(fileInfo);
-            if (this->etag == etag) {
-                httpStatus = 304;
-            } else {
-                std::stringstream buffer;
-                buffer << file.rdbuf();
-                body = buffer.str();
-                this->fileName = filePath;
-                httpStatus = 200;
-            }
+            close(fd);
         }
-        file.close();
+        selectRanges();
+    }
+
+    createResponse(output);
+    clear();
+}
+
+// Same response as createFileResponse, with the body and headers taken from the cache instead of the disk
+void HttpResponse::createCachedFileResponse(OutputQueue &output, const CachedFile &file, const GzipVariant *gzip, const Preconditions &preconditions, const std::map<size_t, GeneratedPage> &errorPages) {
+    const std::string &fileEtag = gzip ? gzip->etag : file.etag;
+    Preconditions::Result result = preconditions.evaluate(fileEtag, file.mtime, true, true);
+    if (result == Preconditions::PRECONDITION_FAILED) {
+        createErrorResponse(output, 412, errorPages);
+        return;
+    }
+
+    lastModified = file.lastModified;
+    etag = fileEtag;
+    cachePolicy.addHeaders(extraHeaders);
+    // A 304 varies like the response it stands for
+    vary = gzip != NULL || compression.isStaticEnabled() || (compression.isEnabled() && Compression::isCompressible(file.contentType));
+    if (result == Preconditions::PRECONDITION_NOT_MODIFIED) {
+        httpStatus = 304;
+    } else {
+        httpStatus = 200;
+        contentType = file.contentType;
+        contentEncoding = gzip ? "gzip" : "";
+        hasFileBody = true;
+        cachedBody = gzip ? gzip->content : file.content;
+        fileOffset = 0;
+        fileSize = cachedBody.size();
+        selectRanges();
     }
 
-    std::string responseString = createResponse();
+    createResponse(output);
     clear();
-    return (responseString);
 }
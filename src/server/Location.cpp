@@ -1,6 +1,6 @@
 #include "Location.hpp"
 
-Location::Location() : logger(Logger("LOCATION")), path(""), root(""), index(LocationConfig::DEFAULT_INDEX), redirect(""), clientBodySize(0), methods(std::vector<Method>()), errorPages(std::vector<std::pair<size_t, std::string> >()), autoindex(false), cgiPaths(), config() {}
+Location::Location() : logger(Logger("LOCATION")), path(""), root(""), index(LocationConfig::DEFAULT_INDEX), redirect(""), clientBodySize(0), methods(std::vector<Method>()), errorPages(std::vector<std::pair<size_t, std::string> >()), autoindex(false), cgiPaths(), fastCgiPass(""), compression(), cachePolicy(), config() {}
 
 Location::Location(const LocationConfig& locationConfig, const std::string& serverRoot) {
     logger = Logger("LOCATION");
@@ -19,7 +19,10 @@ Location::Location(const LocationConfig& locationConfig, const std::string& serv
     errorPages = locationConfig.getErrorPages();
     autoindex = locationConfig.getAutoindex();
     cgiPaths = locationConfig.getCgiPaths();
-    config = Configurations(autoindex, clientBodySize, redirect, root, index, methods, errorPages, cgiPaths);
+    fastCgiPass = locationConfig.getFastCgiPass();
+    compression = locationConfig.getCompression();
+    cachePolicy = locationConfig.getCachePolicy();
+    config = Configurations(autoindex, clientBodySize, redirect, root, index, methods, errorPages, cgiPaths, fastCgiPass, compression, cachePolicy);
 }
 
 Location::Location(const Location& other) {
@@ -38,6 +41,9 @@ Location& Location::operator=(const Location& other) {
         errorPages = other.errorPages;
         autoindex = other.autoindex;
         cgiPaths = other.cgiPaths;
+        fastCgiPass = other.fastCgiPass;
+        compression = other.compression;
+        cachePolicy = other.cachePolicy;
         config = other.config;
     }
     return (*this);
@@ -0,0 +1,184 @@
+#include "MasterProcess.hpp"
+
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "WebServer.hpp"
+#include "utils.h"
+
+const long long MasterProcess::RESPAWN_THROTTLE_IN_MILLIS = 1000;
+
+MasterProcess::MasterProcess() : logger(Logger("MASTER")), config(), workers(), workersStartTimestamp() {
+    sigemptyset(&signals);
+}
+
+MasterProcess::MasterProcess(const Config &config) {
+    logger = Logger("MASTER");
+    this->config = config;
+    workers = std::vector<pid_t>(config.getWorkerProcesses(), 0);
+    workersStartTimestamp = std::vector<long long>(config.getWorkerProcesses(), 0);
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGQUIT);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGCHLD);
+}
+
+MasterProcess::MasterProcess(const MasterProcess &other) {
+    *this = other;
+}
+
+// Workers belong to the process that forked them, a copy starts without any
+MasterProcess &MasterProcess::operator=(const MasterProcess &other) {
+    if (this != &other) {
+        logger = other.logger;
+        config = other.config;
+        workers = std::vector<pid_t>(other.workers.size(), 0);
+        workersStartTimestamp = std::vector<long long>(other.workersStartTimestamp.size(), 0);
+        signals = other.signals;
+    }
+    return (*this);
+}
+
+MasterProcess::~MasterProcess() {}
+
+int MasterProcess::run() {
+    if (workers.size() <= 1) {
+        runServers();
+        return (0);
+    }
+
+    // Signals are only taken through sigwait, so none can slip in between checks
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    logger.info() << "Starting " << workers.size() << " worker processes" << std::endl;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        spawnWorker(i);
+    }
+
+    bool stopping = false;
+    int exitCode = 0;
+    while (countWorkers() > 0) {
+        int signal;
+        if (sigwait(&signals, &signal) != 0) {
+            continue;
+        }
+
+        if (signal == SIGCHLD) {
+            if (!reapWorkers(stopping)) {
+                exitCode = 1;
+            }
+        } else if (!stopping) {
+            logger.info() << "Received signal " << signal << ", stopping workers" << std::endl;
+            stopping = true;
+            forwardSignal(SIGTERM);
+        }
+    }
+    return (exitCode);
+}
+
+void MasterProcess::runServers() {
+    WebServer webServer(config);
+    webServer.setupServers();
+    webServer.runServers();
+}
+
+void MasterProcess::spawnWorker(size_t index) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        logger.perror("fork");
+        return;
+    }
+
+    if (pid == 0) {
+        runWorker(index);
+    }
+
+    workers[index] = pid;
+    workersStartTimestamp[index] = getCurrentTimeMillis();
+    logger.info() << "Worker " << index << " started with pid " << pid << std::endl;
+}
+
+void MasterProcess::runWorker(size_t index) {
+    sigprocmask(SIG_UNBLOCK, &signals, NULL);
+    if (config.getWorkerCpuAffinity()) {
+        pinToCpu(index);
+    }
+
+    try {
+        runServers();
+    } catch (std::exception &e) {
+        logger.error() << "Error: " << e.what() << std::endl;
+        std::exit(1);
+    }
+    std::exit(0);
+}
+
+void MasterProcess::pinToCpu(size_t index) {
+#ifdef __linux__
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0) {
+        return;
+    }
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(index % cpus, &cpuSet);
+    if (sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == -1) {
+        logger.perror("sched_setaffinity");
+    }
+#else
+    (void)index;
+    logger.warn() << "Worker cpu affinity is only supported on Linux" << std::endl;
+#endif
+}
+
+// Crashed workers are restarted, a worker that exits with an error is not, since it would fail again
+bool MasterProcess::reapWorkers(bool stopping) {
+    bool healthy = true;
+    int status;
+    pid_t pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        std::vector<pid_t>::iterator worker = std::find(workers.begin(), workers.end(), pid);
+        if (worker == workers.end()) {
+            continue;
+        }
+        size_t index = worker - workers.begin();
+        workers[index] = 0;
+        if (stopping) {
+            continue;
+        }
+
+        if (WIFSIGNALED(status)) {
+            logger.error() << "Worker " << pid << " killed by signal " << WTERMSIG(status) << ", restarting" << std::endl;
+            if (getCurrentTimeMillis() - workersStartTimestamp[index] < RESPAWN_THROTTLE_IN_MILLIS) {
+                usleep(RESPAWN_THROTTLE_IN_MILLIS * 1000);
+            }
+            spawnWorker(index);
+        } else {
+            logger.error() << "Worker " << pid << " exited with status " << WEXITSTATUS(status) << std::endl;
+            if (WEXITSTATUS(status) != 0) {
+                healthy = false;
+            }
+        }
+    }
+    return (healthy);
+}
+
+void MasterProcess::forwardSignal(int signal) {
+    for (std::vector<pid_t>::iterator it = workers.begin(); it != workers.end(); ++it) {
+        if (*it != 0) {
+            kill(*it, signal);
+        }
+    }
+}
+
+size_t MasterProcess::countWorkers() const {
+    return (workers.size() - std::count(workers.begin(), workers.end(), 0));
+}
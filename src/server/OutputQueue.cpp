@@ -0,0 +1,230 @@
+#include "OutputQueue.hpp"
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+const size_t OutputQueue::WRITE_CHUNK_SIZE = 1024 * 1024 * 1;  // 1 MB
+const int OutputQueue::MAX_IOVECS = 64;
+
+OutputQueue::OutputQueue() : segments(), pendingBytes(0) {}
+
+OutputQueue::OutputQueue(const OutputQueue &other) : segments(), pendingBytes(0) {
+    *this = other;
+}
+
+OutputQueue &OutputQueue::operator=(const OutputQueue &other) {
+    if (this != &other) {
+        clear();
+        segments = other.segments;
+        pendingBytes = other.pendingBytes;
+        for (std::deque<Segment>::iterator it = segments.begin(); it != segments.end(); ++it) {
+            // Every copied segment gets a descriptor of its own, shared ones included
+            if ((*it).fileFd != -1) {
+                (*it).fileFd = dup((*it).fileFd);
+                (*it).ownsFile = true;
+            }
+        }
+    }
+    return (*this);
+}
+
+OutputQueue::~OutputQueue() {
+    clear();
+}
+
+void OutputQueue::push(std::string &data) {
+    if (data.empty()) {
+        return;
+    }
+
+    pendingBytes += data.size();
+    segments.push_back(Segment());
+    Segment &segment = segments.back();
+    segment.data.swap(data);
+    segment.shared = NULL;
+    segment.offset = 0;
+    segment.end = segment.data.size();
+    segment.fileFd = -1;
+    segment.ownsFile = false;
+    segment.fileOffset = 0;
+    segment.fileRemaining = 0;
+}
+
+void OutputQueue::pushShared(const std::string &data) {
+    if (data.empty()) {
+        return;
+    }
+
+    pendingBytes += data.size();
+    segments.push_back(Segment());
+    Segment &segment = segments.back();
+    segment.shared = &data;
+    segment.offset = 0;
+    segment.end = data.size();
+    segment.fileFd = -1;
+    segment.ownsFile = false;
+    segment.fileOffset = 0;
+    segment.fileRemaining = 0;
+}
+
+void OutputQueue::pushShared(const SharedBuffer &buffer, size_t offset, size_t length) {
+    if (length == 0) {
+        return;
+    }
+
+    pendingBytes += length;
+    segments.push_back(Segment());
+    Segment &segment = segments.back();
+    segment.buffer = buffer;
+    segment.shared = &segment.buffer.get();
+    segment.offset = offset;
+    segment.end = offset + length;
+    segment.fileFd = -1;
+    segment.ownsFile = false;
+    segment.fileOffset = 0;
+    segment.fileRemaining = 0;
+}
+
+void OutputQueue::pushFile(int fileFd, off_t offset, off_t size, bool ownsFile) {
+    if (size <= 0) {
+        if (ownsFile) {
+            close(fileFd);
+        }
+        return;
+    }
+
+    pendingBytes += size;
+    segments.push_back(Segment());
+    Segment &segment = segments.back();
+    segment.shared = NULL;
+    segment.offset = 0;
+    segment.end = 0;
+    segment.fileFd = fileFd;
+    segment.ownsFile = ownsFile;
+    segment.fileOffset = offset;
+    segment.fileRemaining = size;
+}
+
+bool OutputQueue::empty() const {
+    return (segments.empty());
+}
+
+// Bytes still to be written
+size_t OutputQueue::size() const {
+    return (pendingBytes);
+}
+
+void OutputQueue::clear() {
+    while (!segments.empty()) {
+        popFront();
+    }
+}
+
+static const std::string &getContent(const std::string &data, const std::string *shared) {
+    return (shared != NULL ? *shared : data);
+}
+
+void OutputQueue::popFront() {
+    Segment &segment = segments.front();
+    pendingBytes -= segment.end - segment.offset + segment.fileRemaining;
+    if (segment.ownsFile) {
+        close(segment.fileFd);
+    }
+    segments.pop_front();
+}
+
+// Falls back to pread when sendfile is unavailable, only what was written advances the offset
+static ssize_t sendFileRegion(int fd, int fileFd, off_t &offset, size_t &count) {
+#ifdef __linux__
+    ssize_t bytesSend = sendfile(fd, fileFd, &offset, count);
+    if (bytesSend != -1 || (errno != EINVAL && errno != ENOSYS)) {
+        return (bytesSend);
+    }
+#endif
+    char buffer[1024 * 64];
+    count = std::min(count, sizeof(buffer));
+    ssize_t bytesRead = pread(fileFd, buffer, count, offset);
+    if (bytesRead <= 0) {
+        return (bytesRead);
+    }
+    ssize_t bytesWritten = write(fd, buffer, bytesRead);
+    if (bytesWritten > 0) {
+        offset += bytesWritten;
+    }
+    return (bytesWritten);
+}
+
+ssize_t OutputQueue::writeFile(int fd, size_t &bytesToSend) {
+    Segment &segment = segments.front();
+
+    bytesToSend = std::min(static_cast<size_t>(segment.fileRemaining), WRITE_CHUNK_SIZE);
+    ssize_t bytesSend = sendFileRegion(fd, segment.fileFd, segment.fileOffset, bytesToSend);
+    if (bytesSend > 0) {
+        segment.fileRemaining -= bytesSend;
+        pendingBytes -= bytesSend;
+        if (segment.fileRemaining == 0) {
+            popFront();
+        }
+    }
+    return (bytesSend);
+}
+
+// Gathers the consecutive memory segments at the front into a single writev
+ssize_t OutputQueue::writeBuffers(int fd, size_t &bytesToSend) {
+    struct iovec iov[MAX_IOVECS];
+    int iovCount = 0;
+
+    bytesToSend = 0;
+    for (std::deque<Segment>::iterator it = segments.begin(); it != segments.end() && (*it).fileFd == -1 && iovCount < MAX_IOVECS && bytesToSend < WRITE_CHUNK_SIZE; ++it) {
+        const std::string &content = getContent((*it).data, (*it).shared);
+        size_t length = std::min((*it).end - (*it).offset, WRITE_CHUNK_SIZE - bytesToSend);
+        iov[iovCount].iov_base = const_cast<char *>(content.data() + (*it).offset);
+        iov[iovCount].iov_len = length;
+        bytesToSend += length;
+        iovCount++;
+    }
+
+    ssize_t bytesSend = writev(fd, iov, iovCount);
+    if (bytesSend <= 0) {
+        return (bytesSend);
+    }
+
+    size_t remaining = bytesSend;
+    while (remaining > 0) {
+        Segment &segment = segments.front();
+        size_t consumed = std::min(segment.end - segment.offset, remaining);
+        segment.offset += consumed;
+        pendingBytes -= consumed;
+        remaining -= consumed;
+        if (segment.offset == segment.end) {
+            popFront();
+        }
+    }
+    return (bytesSend);
+}
+
+OutputQueue::Status OutputQueue::flush(int fd) {
+    while (!segments.empty()) {
+        size_t bytesToSend = 0;
+        ssize_t bytesSend = (segments.front().fileFd != -1) ? writeFile(fd, bytesToSend) : writeBuffers(fd, bytesToSend);
+        if (bytesSend == -1) {
+            return ((errno == EAGAIN || errno == EWOULDBLOCK) ? OUTPUT_PENDING : OUTPUT_ERROR);
+        }
+        if (bytesSend == 0) {
+            // A file that shrank after its size was announced can't be completed
+            return (OUTPUT_ERROR);
+        }
+
+        if (static_cast<size_t>(bytesSend) < bytesToSend) {
+            // A short write means the fd is full, wait for the next writable event
+            return (OUTPUT_PENDING);
+        }
+    }
+    return (OUTPUT_DONE);
+}
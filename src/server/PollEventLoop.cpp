@@ -0,0 +1,61 @@
+#include "PollEventLoop.hpp"
+
+#include "utils.h"
+
+PollEventLoop::PollEventLoop() : fds(), positions() {}
+
+PollEventLoop::~PollEventLoop() {}
+
+void PollEventLoop::watch(int fd, short events) {
+    if (fd < 0) {
+        return;
+    }
+    if (static_cast<size_t>(fd) >= positions.size()) {
+        positions.resize(fd + 1, -1);
+    }
+
+    if (positions[fd] != -1) {
+        fds[positions[fd]].events = events;
+        return;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    positions[fd] = fds.size();
+    fds.push_back(pfd);
+}
+
+void PollEventLoop::unwatch(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= positions.size() || positions[fd] == -1) {
+        return;
+    }
+
+    int position = positions[fd];
+    fds[position] = fds.back();
+    positions[fds[position].fd] = position;
+    fds.pop_back();
+    positions[fd] = -1;
+}
+
+int PollEventLoop::wait(std::vector<struct pollfd> &ready, int timeout) {
+    ready.clear();
+
+    int affected = poll(fds.data(), fds.size(), timeout);
+    if (affected < 0) {
+        return (affected);
+    }
+
+    for (std::vector<struct pollfd>::iterator it = fds.begin(); it != fds.end() && static_cast<int>(ready.size()) < affected; ++it) {
+        if ((*it).revents != 0) {
+            ready.push_back(*it);
+            (*it).revents = 0;
+        }
+    }
+    return (affected);
+}
+
+const std::string &PollEventLoop::getName() const {
+    return (POLL_BACKEND);
+}
@@ -0,0 +1,88 @@
+#include "Preconditions.hpp"
+
+#include "utils.h"
+
+Preconditions::Preconditions() : ifMatch(""), ifNoneMatch(""), ifModifiedSince(-1), ifUnmodifiedSince(-1) {}
+
+Preconditions::Preconditions(const std::string &ifMatch, const std::string &ifNoneMatch, const std::string &ifModifiedSince, const std::string &ifUnmodifiedSince) : ifMatch(ifMatch), ifNoneMatch(ifNoneMatch), ifModifiedSince(parseDate(ifModifiedSince)), ifUnmodifiedSince(parseDate(ifUnmodifiedSince)) {}
+
+Preconditions::Preconditions(const Preconditions &other) : ifMatch(other.ifMatch), ifNoneMatch(other.ifNoneMatch), ifModifiedSince(other.ifModifiedSince), ifUnmodifiedSince(other.ifUnmodifiedSince) {}
+
+Preconditions &Preconditions::operator=(const Preconditions &other) {
+    if (this != &other) {
+        ifMatch = other.ifMatch;
+        ifNoneMatch = other.ifNoneMatch;
+        ifModifiedSince = other.ifModifiedSince;
+        ifUnmodifiedSince = other.ifUnmodifiedSince;
+    }
+    return (*this);
+}
+
+Preconditions::~Preconditions() {}
+
+time_t Preconditions::parseDate(const std::string &date) {
+    time_t time;
+    if (date.empty() || !parseHttpDate(date, time)) {
+        return (-1);
+    }
+    return (time);
+}
+
+// Walks a comma separated list of entity tags, the opaque part of a tag may itself hold commas
+bool Preconditions::matches(const std::string &list, const std::string &etag, bool exists, bool weak) {
+    std::string value = list;
+    trim(value);
+    if (value == "*") {
+        return (exists);
+    }
+    if (!exists || etag.empty()) {
+        return (false);
+    }
+
+    bool etagWeak = etag.compare(0, 2, "W/") == 0;
+    std::string opaque = etagWeak ? etag.substr(2) : etag;
+    size_t pos = 0;
+    while (pos < value.size()) {
+        pos = value.find_first_not_of(" \t,", pos);
+        if (pos == std::string::npos) {
+            break;
+        }
+        bool tagWeak = value.compare(pos, 2, "W/") == 0;
+        if (tagWeak) {
+            pos += 2;
+        }
+        if (pos >= value.size() || value[pos] != '"') {
+            return (false);
+        }
+        size_t end = value.find('"', pos + 1);
+        if (end == std::string::npos) {
+            return (false);
+        }
+        // The strong comparison used by If-Match needs both tags to be strong
+        if (value.compare(pos, end + 1 - pos, opaque) == 0 && (weak || (!tagWeak && !etagWeak))) {
+            return (true);
+        }
+        pos = end + 1;
+    }
+    return (false);
+}
+
+// Same order as RFC 9110 section 13.2.2, a date is only looked at when there is no tag to compare
+Preconditions::Result Preconditions::evaluate(const std::string &etag, time_t lastModified, bool exists, bool safeMethod) const {
+    if (!ifMatch.empty()) {
+        if (!matches(ifMatch, etag, exists, false)) {
+            return (PRECONDITION_FAILED);
+        }
+    } else if (ifUnmodifiedSince != -1 && exists && lastModified > ifUnmodifiedSince) {
+        return (PRECONDITION_FAILED);
+    }
+
+    if (!ifNoneMatch.empty()) {
+        if (matches(ifNoneMatch, etag, exists, true)) {
+            return (safeMethod ? PRECONDITION_NOT_MODIFIED : PRECONDITION_FAILED);
+        }
+    } else if (safeMethod && ifModifiedSince != -1 && exists && lastModified <= ifModifiedSince) {
+        return (PRECONDITION_NOT_MODIFIED);
+    }
+    return (PRECONDITION_PASSED);
+}
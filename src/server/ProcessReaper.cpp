@@ -0,0 +1,153 @@
+#include "ProcessReaper.hpp"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "Client.hpp"
+#include "utils.h"
+
+const long long ProcessReaper::KILL_DELAY_IN_MILLIS = 1000;  // 1 second
+
+int ProcessReaper::signalFd = -1;
+
+ProcessReaper::ProcessReaper() : logger("REAPER"), timers(NULL), killTimer(), children(), terminating() {
+    pipeFds[0] = pipeFds[1] = -1;
+}
+
+// The pipe and the handler belong to the reaper that installed them, a copy starts uninitialized
+ProcessReaper::ProcessReaper(const ProcessReaper &other) : logger("REAPER"), timers(NULL), killTimer(), children(), terminating() {
+    (void)other;
+    pipeFds[0] = pipeFds[1] = -1;
+}
+
+ProcessReaper &ProcessReaper::operator=(const ProcessReaper &other) {
+    if (this != &other) {
+        close();
+    }
+    return (*this);
+}
+
+ProcessReaper::~ProcessReaper() {
+    close();
+}
+
+void ProcessReaper::close() {
+    if (pipeFds[0] == -1) {
+        return;
+    }
+    signal(SIGCHLD, SIG_DFL);
+    signalFd = -1;
+    ::close(pipeFds[0]);
+    ::close(pipeFds[1]);
+    pipeFds[0] = pipeFds[1] = -1;
+    killTimer.cancel();
+    timers = NULL;
+    children.clear();
+    terminating.clear();
+}
+
+// Only writes a byte, the reaping itself happens in the event loop where it can reach the clients
+void ProcessReaper::handleSignal(int signal) {
+    (void)signal;
+    int savedErrno = errno;
+    if (signalFd != -1) {
+        ssize_t written = write(signalFd, "", 1);
+        (void)written;
+    }
+    errno = savedErrno;
+}
+
+int ProcessReaper::init(TimerWheel &timers) {
+    if (pipeFds[0] != -1) {
+        return (pipeFds[0]);
+    }
+
+    // A full pipe already holds a pending wake up, so the handler never has to block
+    if (pipe(pipeFds) == -1) {
+        throw createError("pipe");
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (fcntl(pipeFds[i], F_SETFL, O_NONBLOCK) == -1 || fcntl(pipeFds[i], F_SETFD, FD_CLOEXEC) == -1) {
+            close();
+            throw createError("fcntl");
+        }
+    }
+    signalFd = pipeFds[1];
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = handleSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    if (sigaction(SIGCHLD, &action, NULL) == -1) {
+        close();
+        throw createError("sigaction");
+    }
+
+    this->timers = &timers;
+    killTimer = Timer(pipeFds[0], TIMER_KILL);
+    return (pipeFds[0]);
+}
+
+void ProcessReaper::watch(pid_t pid, Client *client) {
+    children[pid] = client;
+}
+
+// The process stays unreaped until it exits, so its pid can't be reused before the SIGKILL
+void ProcessReaper::terminate(pid_t pid) {
+    children.erase(pid);
+    if (kill(pid, SIGTERM) == -1) {
+        return;
+    }
+    terminating.push_back(std::make_pair(pid, getCurrentTimeMillis() + KILL_DELAY_IN_MILLIS));
+    if (timers != NULL && !killTimer.isScheduled()) {
+        timers->schedule(killTimer, KILL_DELAY_IN_MILLIS);
+    }
+}
+
+void ProcessReaper::reap(std::vector<Client *> &notified) {
+    char buffer[64];
+    while (read(pipeFds[0], buffer, sizeof(buffer)) > 0) {
+    }
+
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        std::map<pid_t, Client *>::iterator child = children.find(pid);
+        if (child == children.end()) {
+            forget(pid);
+            continue;
+        }
+        Client *client = child->second;
+        children.erase(child);
+        client->processCgiExit(status);
+        notified.push_back(client);
+    }
+}
+
+void ProcessReaper::forget(pid_t pid) {
+    for (std::deque<std::pair<pid_t, long long> >::iterator it = terminating.begin(); it != terminating.end(); ++it) {
+        if (it->first == pid) {
+            terminating.erase(it);
+            return;
+        }
+    }
+}
+
+// Every process gets the same delay, so the queue is ordered by deadline
+void ProcessReaper::processTimeout() {
+    long long now = getCurrentTimeMillis();
+    while (!terminating.empty() && terminating.front().second <= now) {
+        logger.warn() << "Process " << terminating.front().first << " ignored SIGTERM, killing it" << std::endl;
+        kill(terminating.front().first, SIGKILL);
+        terminating.pop_front();
+    }
+    if (!terminating.empty() && timers != NULL) {
+        timers->schedule(killTimer, terminating.front().second - now);
+    }
+}
@@ -5,7 +5,7 @@
 
 #include <cstring>
 
-Server::Server() : logger(Logger("SERVER")), port(-1), host(INADDR_ANY), name(""), root(""), index(LocationConfig::DEFAULT_INDEX), clientBodySize(LocationConfig::DEFAULT_CLIENT_BODY_SIZE), methods(std::vector<Method>(GET)), locations(std::vector<Location>()), errorPages(std::vector<std::pair<size_t, std::string> >()), autoindex(false), config() {}
+Server::Server() : logger(Logger("SERVER")), port(-1), host(INADDR_ANY), name(""), root(""), index(LocationConfig::DEFAULT_INDEX), clientBodySize(LocationConfig::DEFAULT_CLIENT_BODY_SIZE), methods(std::vector<Method>(GET)), locations(std::vector<Location>()), errorPages(std::vector<std::pair<size_t, std::string> >()), autoindex(false), keepaliveTimeout(ServerConfig::DEFAULT_KEEPALIVE_TIMEOUT), keepaliveRequests(ServerConfig::DEFAULT_KEEPALIVE_REQUESTS), config(), fileCache(ServerConfig::DEFAULT_FILE_CACHE_SIZE), autoindexCache() {}
 
 Server::Server(const ServerConfig &serverConfig) {
     logger = Logger("SERVER");
@@ -21,12 +21,15 @@ Server::Server(const ServerConfig &serverConfig) {
     }
     errorPages = serverConfig.getErrorPages();
     autoindex = serverConfig.getAutoindex();
+    keepaliveTimeout = serverConfig.getKeepaliveTimeout();
+    keepaliveRequests = serverConfig.getKeepaliveRequests();
+    fileCache = FileCache(serverConfig.getFileCacheSize());
 
     std::vector<LocationConfig> locationsConfig = serverConfig.getLocations();
     for (std::vector<LocationConfig>::iterator it = locationsConfig.begin(); it != locationsConfig.end(); ++it) {
         locations.push_back(Location(*it, serverConfig.getRoot()));
     }
-    config = Configurations(autoindex, clientBodySize, "", root, index, methods, errorPages, std::map<std::string, std::string>());
+    config = Configurations(autoindex, clientBodySize, "", root, index, methods, errorPages, std::map<std::string, std::string>(), "", serverConfig.getCompression(), serverConfig.getCachePolicy());
 }
 
 Server::Server(const Server &other) {
@@ -46,7 +49,11 @@ Server &Server::operator=(const Server &other) {
         locations = other.locations;
         errorPages = other.errorPages;
         autoindex = other.autoindex;
+        keepaliveTimeout = other.keepaliveTimeout;
+        keepaliveRequests = other.keepaliveRequests;
         config = other.config;
+        fileCache = other.fileCache;
+        autoindexCache = other.autoindexCache;
     }
     return (*this);
 }
@@ -110,6 +117,22 @@ size_t Server::getClientBodySize() const {
     return (clientBodySize);
 }
 
+size_t Server::getKeepaliveTimeout() const {
+    return (keepaliveTimeout);
+}
+
+size_t Server::getKeepaliveRequests() const {
+    return (keepaliveRequests);
+}
+
 const Configurations &Server::getConfig() const {
     return (config);
 }
+
+FileCache &Server::getFileCache() const {
+    return (fileCache);
+}
+
+AutoindexCache &Server::getAutoindexCache() const {
+    return (autoindexCache);
+}
@@ -14,14 +14,16 @@
 
 const size_t ServerManager::MAX_CLIENTS = 1000;
 
-ServerManager::ServerManager() : logger(Logger("SERVER_MANAGER")), socketFd(0), port(-1), host(INADDR_ANY), servers(std::vector<Server>()), clients(std::vector<Client>()), request(HttpRequest()), response(HttpResponse()) {}
+ServerManager::ServerManager() : logger(Logger("SERVER_MANAGER")), socketFd(0), port(-1), host(INADDR_ANY), servers(std::vector<Server>()), clientPool(), fastCgiPool(), processReaper(NULL), clients(std::vector<Client*>()), clientPositions(), request(HttpRequest()), response(HttpResponse()) {}
 
 ServerManager::ServerManager(const std::vector<ServerConfig>& serverConfig) {
     logger = Logger("SERVER_MANAGER");
     socketFd = 0;
+    processReaper = NULL;
     port = serverConfig.front().getPort();
     host = serverConfig.front().getHost();
-    clients = std::vector<Client>();
+    clients = std::vector<Client*>();
+    clientPositions = std::vector<int>();
     request = HttpRequest();
     response = HttpResponse();
 
@@ -41,7 +43,11 @@ ServerManager& ServerManager::operator=(const ServerManager& other) {
         port = other.port;
         host = other.host;
         servers = other.servers;
-        clients = other.clients;
+        clientPool = other.clientPool;
+        fastCgiPool = other.fastCgiPool;
+        processReaper = other.processReaper;
+        clients = std::vector<Client*>();
+        clientPositions = std::vector<int>();
         request = other.request;
         response = other.response;
     }
@@ -53,9 +59,15 @@ ServerManager::~ServerManager() {}
 int ServerManager::initServer() {
     socketFd = socket(AF_INET, SOCK_STREAM, 0);
 
-#ifndef __APPLE__
     int optval = 1;
-    if (setsockopt(socketFd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &optval, sizeof(optval)) == -1) {
+    if (setsockopt(socketFd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) == -1) {
+        close(socketFd);
+        throw createError("setsockopt");
+    }
+
+#ifndef __APPLE__
+    // Every worker binds its own listener, the kernel balances connections between them
+    if (setsockopt(socketFd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) == -1) {
         close(socketFd);
         throw createError("setsockopt");
     }
@@ -75,6 +87,16 @@ int ServerManager::initServer() {
         throw createError("listen");
     }
 
+    int flags = fcntl(socketFd, F_GETFL, 0);
+    if (flags == -1 || fcntl(socketFd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        throw createError("fcntl");
+    }
+
+    // A script inheriting the listener would take a share of the connections for as long as it lives
+    if (fcntl(socketFd, F_SETFD, FD_CLOEXEC) == -1) {
+        throw createError("fcntl");
+    }
+
     char ipStr[INET_ADDRSTRLEN];
     inet_ntop(AF_INET, &host, ipStr, INET_ADDRSTRLEN);
     logger.info() << "ServerManager " << ipStr << " started on port " << port << std::endl;
@@ -82,10 +104,18 @@ int ServerManager::initServer() {
     return (socketFd);
 }
 
-void ServerManager::verifyClientsCgiTimeout(std::vector<int>& fdsToRemove) {
-    for (std::vector<Client>::iterator it = clients.begin(); it != clients.end(); ++it) {
-        it->verifyCgiTimeout(fdsToRemove);
+void ServerManager::processTimeout(const Timer& timer, std::vector<int>& fdsToRemove, EventLoop& eventLoop, FdRegistry& registry, TimerWheel& timers) {
+    Client& client = *registry.get(timer.getFd()).client;
+
+    if (timer.getType() == TIMER_CGI) {
+        client.processCgiTimeout(fdsToRemove);
+        client.updateEvents(eventLoop);
+        client.updateTimers(timers);
+        return;
     }
+
+    logger.info() << "Closing idle connection " << timer.getFd() << std::endl;
+    fdsToRemove.push_back(removeClient(timer.getFd(), eventLoop, registry));
 }
 
 std::vector<int> ServerManager::finishServer() const {
@@ -93,101 +123,114 @@ std::vector<int> ServerManager::finishServer() const {
         close(socketFd);
 
     std::vector<int> allFds;
-    for (std::vector<Client>::const_iterator it = clients.begin(); it != clients.end(); ++it) {
-        close(it->getFd());
-        allFds.push_back(it->getFd());
+    for (std::vector<Client*>::const_iterator it = clients.begin(); it != clients.end(); ++it) {
+        close((*it)->getFd());
+        allFds.push_back((*it)->getFd());
     }
 
     allFds.push_back(socketFd);
     return (allFds);
 }
 
-int ServerManager::acceptConnection() {
+Client* ServerManager::acceptConnection() {
     struct sockaddr_in clientAddress;
     socklen_t clientAddressLen = sizeof(clientAddress);
     int clientFd = accept(socketFd, (struct sockaddr*)&clientAddress, &clientAddressLen);
     if (clientFd == -1) {
-        logger.perror("accept");
-        return (-1);
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            logger.perror("accept");
+        }
+        return (NULL);
     }
 
     int flags = fcntl(clientFd, F_GETFL, 0);
     if (flags == -1) {
         close(clientFd);
         logger.perror("fcntl");
-        return (-1);
+        return (NULL);
     }
 
-    if (fcntl(clientFd, F_SETFL, flags | O_NONBLOCK) == -1) {
+    if (fcntl(clientFd, F_SETFL, flags | O_NONBLOCK) == -1 || fcntl(clientFd, F_SETFD, FD_CLOEXEC) == -1) {
         close(clientFd);
         logger.perror("fcntl");
-        return (-1);
+        return (NULL);
     }
 
-    clients.push_back(clientFd);
-    return (clientFd);
-}
-
-int ServerManager::processClientRequest(int clientSocket, std::vector<pollfd>& fdsToAdd) {
-    Client& client = getClient(clientSocket);
-    int fd = client.processSendedData(clientSocket, servers, fdsToAdd);
-    if (fd != 0) {
-        return (fd == client.getFd() ? removeClient(fd) : fd);
+    if (static_cast<size_t>(clientFd) >= clientPositions.size()) {
+        clientPositions.resize(clientFd + 1, -1);
     }
-    return (0);
+    Client* client = clientPool.acquire(clientFd);
+    clientPositions[clientFd] = clients.size();
+    clients.push_back(client);
+    // Until a request names its virtual host, the default server's timeout applies
+    client->setKeepaliveTimeout(servers.front().getKeepaliveTimeout());
+    client->setFastCgiPool(&fastCgiPool);
+    client->setProcessReaper(processReaper);
+    return (client);
 }
 
-int ServerManager::processHandUp(int clientSocket) {
-    Client& client = getClient(clientSocket);
-    client.readCgiResponse();
-    return (clientSocket);
+int ServerManager::processClientRequest(int fd, EventLoop& eventLoop, FdRegistry& registry, TimerWheel& timers) {
+    Client& client = *registry.get(fd).client;
+    int fdToRemove = client.processSendedData(fd, servers, eventLoop, registry);
+    if (fdToRemove != 0 && fdToRemove == client.getFd()) {
+        return (removeClient(fdToRemove, eventLoop, registry));
+    }
+    client.updateEvents(eventLoop);
+    client.updateTimers(timers);
+    return (fdToRemove);
 }
 
-int ServerManager::sendClientResponse(int clientSocket) {
-    Client& client = getClient(clientSocket);
-    int fd = client.sendResponse(clientSocket);
-    if (fd != 0) {
-        return (fd == client.getFd() ? removeClient(fd) : fd);
+int ServerManager::processHandUp(int fd, EventLoop& eventLoop, FdRegistry& registry, TimerWheel& timers) {
+    const FdEntry& entry = registry.get(fd);
+    if (entry.role == FD_CLIENT) {
+        return (removeClient(fd, eventLoop, registry));
     }
-    return (0);
+
+    Client& client = *entry.client;
+    client.processHandUp(fd);
+    client.updateEvents(eventLoop);
+    client.updateTimers(timers);
+    return (fd);
 }
 
-int ServerManager::removeClient(int clientSocket) {
-    for (std::vector<Client>::iterator it = clients.begin(); it != clients.end(); ++it) {
-        if ((*it).getFd() == clientSocket) {
-            it->closeAll();
-            clients.erase(it);
+int ServerManager::sendClientResponse(int fd, EventLoop& eventLoop, FdRegistry& registry, TimerWheel& timers) {
+    // An upstream connection is written and read in the same pass
+    if (registry.get(fd).role == FD_FASTCGI) {
+        return (processClientRequest(fd, eventLoop, registry, timers));
+    }
+    Client& client = *registry.get(fd).client;
+    int fdToRemove = client.sendResponse(fd);
+    // Requests held back while the output drained are answered and written right away,
+    // edge-triggered backends won't report the socket writable again
+    while (fdToRemove == 0 && fd == client.getFd() && !client.hasPendingOutput()) {
+        fdToRemove = client.resumeRequests(servers, eventLoop, registry);
+        if (fdToRemove != 0 || !client.hasPendingOutput()) {
             break;
         }
+        fdToRemove = client.sendResponse(fd);
     }
-    return (clientSocket);
-}
-
-bool ServerManager::isPipeOutClient(int clientSocket) {
-    for (std::vector<Client>::iterator it = clients.begin(); it != clients.end(); ++it) {
-        if ((*it).getPipeOut() == clientSocket) {
-            return (true);
-        }
+    if (fdToRemove != 0 && fdToRemove == client.getFd()) {
+        return (removeClient(fdToRemove, eventLoop, registry));
     }
-    return (false);
+    client.updateEvents(eventLoop);
+    client.updateTimers(timers);
+    return (fdToRemove);
 }
 
-Client& ServerManager::getClient(int clientSocket) {
-    for (std::vector<Client>::iterator it = clients.begin(); it != clients.end(); ++it) {
-        if ((*it).isFdValid(clientSocket)) {
-            return (*it);
-        }
+int ServerManager::removeClient(int clientSocket, EventLoop& eventLoop, FdRegistry& registry) {
+    if (clientSocket < 0 || static_cast<size_t>(clientSocket) >= clientPositions.size() || clientPositions[clientSocket] == -1) {
+        return (clientSocket);
     }
-    throw createError("Client not found");
-}
 
-bool ServerManager::isClient(int clientSocket) const {
-    for (std::vector<Client>::const_iterator it = clients.begin(); it != clients.end(); ++it) {
-        if (it->isFdValid(clientSocket)) {
-            return (true);
-        }
-    }
-    return (false);
+    int position = clientPositions[clientSocket];
+    Client* client = clients[position];
+    client->closeAll(eventLoop, registry);
+    clients[position] = clients.back();
+    clientPositions[clients[position]->getFd()] = position;
+    clients.pop_back();
+    clientPositions[clientSocket] = -1;
+    clientPool.release(client);
+    return (clientSocket);
 }
 
 int ServerManager::getPort() const {
@@ -201,3 +244,7 @@ in_addr_t ServerManager::getHost() const {
 int ServerManager::getFd() const {
     return (socketFd);
 }
+
+void ServerManager::setProcessReaper(ProcessReaper* reaper) {
+    processReaper = reaper;
+}
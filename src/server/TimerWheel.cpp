@@ -0,0 +1,222 @@
+#include "TimerWheel.hpp"
+
+#include <climits>
+#include <cstddef>
+
+#include "utils.h"
+
+const long long TimerWheel::TICK_IN_MILLIS = 10;
+const int TimerWheel::LEVEL_BITS = 6;
+const int TimerWheel::LEVELS = 4;
+
+static const long long SLOTS = 1LL << TimerWheel::LEVEL_BITS;
+
+Timer::Timer() : fd(-1), type(TIMER_IDLE), expires(0), prev(NULL), next(NULL) {}
+
+Timer::Timer(int fd, TimerType type) : fd(fd), type(type), expires(0), prev(NULL), next(NULL) {}
+
+Timer::Timer(const Timer &other) : fd(other.fd), type(other.type), expires(0), prev(NULL), next(NULL) {}
+
+Timer &Timer::operator=(const Timer &other) {
+    if (this != &other) {
+        cancel();
+        fd = other.fd;
+        type = other.type;
+    }
+    return (*this);
+}
+
+Timer::~Timer() {
+    cancel();
+}
+
+int Timer::getFd() const {
+    return (fd);
+}
+
+TimerType Timer::getType() const {
+    return (type);
+}
+
+bool Timer::isScheduled() const {
+    return (next != NULL);
+}
+
+void Timer::cancel() {
+    if (next == NULL) {
+        return;
+    }
+    prev->next = next;
+    next->prev = prev;
+    prev = NULL;
+    next = NULL;
+}
+
+TimerWheel::TimerWheel() : currentTick(0), slots(), expired() {
+    init();
+}
+
+TimerWheel::TimerWheel(const TimerWheel &other) : currentTick(0), slots(), expired() {
+    *this = other;
+}
+
+// Scheduled timers belong to a single wheel, the copy starts empty
+TimerWheel &TimerWheel::operator=(const TimerWheel &other) {
+    if (this != &other) {
+        clear();
+        init();
+    }
+    return (*this);
+}
+
+TimerWheel::~TimerWheel() {
+    clear();
+}
+
+void TimerWheel::init() {
+    currentTick = getCurrentTimeMillis() / TICK_IN_MILLIS;
+    slots = std::vector<Timer>(LEVELS * SLOTS);
+    for (std::vector<Timer>::iterator it = slots.begin(); it != slots.end(); ++it) {
+        initList(*it);
+    }
+    initList(expired);
+}
+
+void TimerWheel::clear() {
+    for (std::vector<Timer>::iterator it = slots.begin(); it != slots.end(); ++it) {
+        while ((*it).next != &(*it)) {
+            (*it).next->cancel();
+        }
+    }
+    if (expired.next != NULL) {
+        while (expired.next != &expired) {
+            expired.next->cancel();
+        }
+    }
+}
+
+void TimerWheel::schedule(Timer &timer, long long delayInMillis) {
+    timer.cancel();
+    // Rounds up so a timer never fires before its delay
+    timer.expires = currentTick + delayInMillis / TICK_IN_MILLIS + 1;
+    insert(timer);
+}
+
+void TimerWheel::advance(long long now) {
+    long long target = now / TICK_IN_MILLIS;
+
+    if (target - currentTick > SLOTS && isEmpty()) {
+        currentTick = target;
+        return;
+    }
+
+    while (currentTick < target) {
+        currentTick++;
+        for (int level = 1; level < LEVELS; ++level) {
+            if ((currentTick & ((1LL << (level * LEVEL_BITS)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+
+        Timer &head = slots[slotIndex(0, currentTick)];
+        while (head.next != &head) {
+            Timer &timer = *head.next;
+            timer.cancel();
+            link(expired, timer);
+        }
+    }
+}
+
+Timer *TimerWheel::popExpired() {
+    if (expired.next == &expired) {
+        return (NULL);
+    }
+    Timer *timer = expired.next;
+    timer->cancel();
+    return (timer);
+}
+
+// Milliseconds until the wheel has work to do, -1 when nothing is scheduled
+int TimerWheel::nextTimeout(long long now) const {
+    if (expired.next != &expired) {
+        return (0);
+    }
+
+    long long nextTick = -1;
+    for (int level = 0; level < LEVELS; ++level) {
+        int shift = level * LEVEL_BITS;
+        for (long long offset = 1; offset <= SLOTS; ++offset) {
+            // Timers on upper levels are due no sooner than the tick that cascades their slot
+            long long tick = ((currentTick >> shift) + offset) << shift;
+            const Timer &head = slots[slotIndex(level, tick)];
+            if (head.next != &head) {
+                if (nextTick == -1 || tick < nextTick) {
+                    nextTick = tick;
+                }
+                break;
+            }
+        }
+    }
+
+    if (nextTick == -1) {
+        return (-1);
+    }
+    long long timeout = nextTick * TICK_IN_MILLIS - now;
+    if (timeout < 0) {
+        return (0);
+    }
+    return (timeout > INT_MAX ? INT_MAX : static_cast<int>(timeout));
+}
+
+void TimerWheel::insert(Timer &timer) {
+    long long delta = timer.expires - currentTick;
+    if (delta <= 0) {
+        link(expired, timer);
+        return;
+    }
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1LL << ((level + 1) * LEVEL_BITS))) {
+        level++;
+    }
+    long long span = 1LL << (LEVELS * LEVEL_BITS);
+    if (delta >= span) {
+        timer.expires = currentTick + span - 1;
+    }
+    link(slots[slotIndex(level, timer.expires)], timer);
+}
+
+void TimerWheel::cascade(int level) {
+    Timer &head = slots[slotIndex(level, currentTick)];
+    while (head.next != &head) {
+        Timer &timer = *head.next;
+        timer.cancel();
+        insert(timer);
+    }
+}
+
+bool TimerWheel::isEmpty() const {
+    for (std::vector<Timer>::const_iterator it = slots.begin(); it != slots.end(); ++it) {
+        if ((*it).next != &(*it)) {
+            return (false);
+        }
+    }
+    return (expired.next == &expired);
+}
+
+size_t TimerWheel::slotIndex(int level, long long tick) {
+    return (level * SLOTS + ((tick >> (level * LEVEL_BITS)) & (SLOTS - 1)));
+}
+
+void TimerWheel::initList(Timer &head) {
+    head.prev = &head;
+    head.next = &head;
+}
+
+void TimerWheel::link(Timer &head, Timer &timer) {
+    timer.prev = head.prev;
+    timer.next = &head;
+    head.prev->next = &timer;
+    head.prev = &timer;
+}
@@ -3,18 +3,16 @@
 #include <poll.h>
 #include <unistd.h>
 
-#include <algorithm>
+#include <cerrno>
 
-const size_t WebServer::MAX_EVENTS = 1000;
-const size_t WebServer::POLL_TIMEOUT = 1000;
+#include "utils.h"
 
-WebServer::WebServer() : logger(Logger("SERVER_MANAGER")), fds(std::vector<struct pollfd>()), servers(std::vector<ServerManager>()) {
-    fds.reserve(MAX_EVENTS);
-}
+WebServer::WebServer() : logger(Logger("SERVER_MANAGER")), eventBackend(EventLoop::DEFAULT_BACKEND), eventLoop(NULL), registry(), timers(), reaper(), servers(std::vector<ServerManager>()) {}
 
 WebServer::WebServer(const Config& config) {
-    fds.reserve(MAX_EVENTS);
     logger = Logger("SERVER_MANAGER");
+    eventBackend = config.getEventBackend();
+    eventLoop = NULL;
 
     std::vector<ServerConfig> serversConfig = config.getServers();
     verifyDuplicatedServers(serversConfig);
@@ -39,140 +37,163 @@ WebServer::WebServer(const Config& config) {
     }
 }
 
-WebServer::WebServer(const WebServer& other) {
+WebServer::WebServer(const WebServer& other) : eventLoop(NULL) {
     *this = other;
 }
 
 WebServer& WebServer::operator=(const WebServer& other) {
     if (this != &other) {
         logger = other.logger;
+        eventBackend = other.eventBackend;
         servers = other.servers;
-        fds = other.fds;
+        registry = FdRegistry();
+        timers = TimerWheel();
     }
-    fds.reserve(MAX_EVENTS);
     return (*this);
 }
 
 WebServer::~WebServer() {
     finishServers();
+    delete eventLoop;
 }
 
 void WebServer::setupServers() {
+    if (eventLoop == NULL) {
+        eventLoop = EventLoop::create(eventBackend);
+    }
+
+    int signalFd = reaper.init(timers);
+    registry.add(signalFd, FD_SIGNAL, NULL, NULL);
+    eventLoop->watch(signalFd, POLLIN);
+
     for (std::vector<ServerManager>::iterator it = servers.begin(); it != servers.end(); ++it) {
         int socketFd = (*it).initServer();
-        struct pollfd fd;
-        fd.fd = socketFd;
-        fd.events = POLLIN;
-        fd.revents = 0;
-        fds.push_back(fd);
+        registry.add(socketFd, FD_LISTENER, &(*it), NULL);
+        eventLoop->watch(socketFd, POLLIN);
+        (*it).setProcessReaper(&reaper);
     }
 }
 
 void WebServer::runServers() {
     std::vector<int> fdsToRemove;
-    std::vector<pollfd> fdsToAdd;
+    std::vector<struct pollfd> ready;
 
+    logger.info() << "Using " << eventLoop->getName() << " event backend" << std::endl;
     while (true) {
         try {
-            int affected = 0;
-            int currentAffected = 0;
-            if ((affected = poll(fds.data(), fds.size(), POLL_TIMEOUT)) < 0) {
+            // A SIGCHLD interrupts the wait, the self-pipe reports it on the next one
+            if (eventLoop->wait(ready, timers.nextTimeout(getCurrentTimeMillis())) < 0 && errno != EINTR) {
                 throw createError("poll");
             }
+        } catch (std::exception& e) {
+            logger.error() << "Error: " << e.what() << std::endl;
+            continue;
+        }
 
-            for (std::vector<struct pollfd>::iterator fd = fds.begin(); fd != fds.end() && currentAffected < affected; ++fd) {
-                if ((*fd).revents == 0) {
-                    continue;
-                }
-
-                currentAffected++;
-                if ((*fd).revents & POLLIN) {
-                    std::vector<ServerManager>::iterator server = findServerFd((*fd).fd);
-
-                    if (server != servers.end()) {
-                        int clientFd = (*server).acceptConnection();
-                        if (clientFd < 0) {
-                            logger.perror("accept");
-                            continue;
-                        }
-                        struct pollfd pfd;
-                        pfd.fd = clientFd;
-                        pfd.events = POLLIN | POLLOUT | POLLNVAL | POLLHUP | POLLERR;
-                        pfd.revents = 0;
-                        fdsToAdd.push_back(pfd);
-                    } else {
-                        std::vector<ServerManager>::iterator it = findServerClientFd((*fd).fd);
-                        if ((*it).processClientRequest((*fd).fd, fdsToAdd) != 0) {
-                            fdsToRemove.push_back((*fd).fd);
-                        }
-                    }
-                } else if ((*fd).revents & POLLOUT) {
-                    std::vector<ServerManager>::iterator it = findServerClientFd((*fd).fd);
-                    if ((*it).sendClientResponse((*fd).fd) != 0) {
-                        fdsToRemove.push_back((*fd).fd);
-                    }
-                } else if ((*fd).revents & POLLNVAL) {
-                    logger.error() << "Invalid request on fd " << (*fd).fd << std::endl;
-                    fdsToRemove.push_back((*fd).fd);
-                } else if ((*fd).revents & POLLERR) {
-                    logger.error() << "Error on fd " << (*fd).fd << std::endl;
-                    fdsToRemove.push_back((*fd).fd);
-                } else if ((*fd).revents & POLLHUP) {
-                    std::vector<ServerManager>::iterator it = findServerClientPipeOutput((*fd).fd);
-                    (*it).processHandUp((*fd).fd);
-                    fdsToRemove.push_back((*fd).fd);
-                } else {
-                    logger.error() << "Unknown event on fd " << (*fd).fd << " events: " << (*fd).revents << std::endl;
-                }
-            }
+        timers.advance(getCurrentTimeMillis());
 
-            for (std::vector<ServerManager>::iterator it = servers.begin(); it != servers.end(); ++it) {
-                (*it).verifyClientsCgiTimeout(fdsToRemove);
+        for (std::vector<struct pollfd>::iterator event = ready.begin(); event != ready.end(); ++event) {
+            try {
+                handleEvent(*event);
+            } catch (std::exception& e) {
+                logger.error() << "Error: " << e.what() << std::endl;
             }
+        }
 
-            for (std::vector<int>::iterator it = fdsToRemove.begin(); it != fdsToRemove.end(); ++it) {
-                removeClient(*it);
+        Timer* timer;
+        while ((timer = timers.popExpired()) != NULL) {
+            try {
+                handleTimeout(*timer, fdsToRemove);
+            } catch (std::exception& e) {
+                logger.error() << "Error: " << e.what() << std::endl;
             }
-            fdsToRemove.clear();
+        }
 
-            for (std::vector<pollfd>::iterator it = fdsToAdd.begin(); it != fdsToAdd.end(); ++it) {
-                fds.push_back(*it);
-            }
-            fdsToAdd.clear();
-        } catch (std::exception& e) {
-            logger.error() << "Error: " << e.what() << std::endl;
+        for (std::vector<int>::iterator it = fdsToRemove.begin(); it != fdsToRemove.end(); ++it) {
+            removeClient(*it);
         }
+        fdsToRemove.clear();
     }
 }
 
-std::vector<ServerManager>::iterator WebServer::findServerClientFd(int clientFd) {
-    for (std::vector<ServerManager>::iterator it = servers.begin(); it != servers.end(); ++it) {
-        if (it->isClient(clientFd)) {
-            return (it);
+void WebServer::handleEvent(const struct pollfd& event) {
+    const FdEntry& entry = registry.get(event.fd);
+
+    if (entry.role == FD_NONE) {
+        logger.warn() << "Event on unknown fd " << event.fd << std::endl;
+        eventLoop->unwatch(event.fd);
+        return;
+    }
+    if (entry.role == FD_SIGNAL) {
+        reapProcesses();
+        return;
+    }
+
+    ServerManager& server = *entry.server;
+    if (entry.role == FD_LISTENER) {
+        acceptConnections(server);
+    } else if (event.revents & POLLIN) {
+        if (server.processClientRequest(event.fd, *eventLoop, registry, timers) != 0) {
+            removeClient(event.fd);
         }
+    } else if (event.revents & POLLOUT) {
+        if (server.sendClientResponse(event.fd, *eventLoop, registry, timers) != 0) {
+            removeClient(event.fd);
+        }
+    } else if (event.revents & (POLLNVAL | POLLERR | POLLHUP)) {
+        if (event.revents & POLLNVAL) {
+            logger.error() << "Invalid request on fd " << event.fd << std::endl;
+        } else if (event.revents & POLLERR) {
+            logger.error() << "Error on fd " << event.fd << std::endl;
+        }
+        removeClient(server.processHandUp(event.fd, *eventLoop, registry, timers));
+    } else {
+        logger.error() << "Unknown event on fd " << event.fd << " events: " << event.revents << std::endl;
     }
+}
 
-    throw std::runtime_error("Client with fd " + numberToString(clientFd) + " not found");
+void WebServer::acceptConnections(ServerManager& server) {
+    Client* client;
+    while ((client = server.acceptConnection()) != NULL) {
+        registry.add(client->getFd(), FD_CLIENT, &server, client);
+        eventLoop->watch(client->getFd(), POLLIN);
+        client->updateTimers(timers);
+    }
 }
 
-std::vector<ServerManager>::iterator WebServer::findServerClientPipeOutput(int clientFd) {
-    for (std::vector<ServerManager>::iterator it = servers.begin(); it != servers.end(); ++it) {
-        if (it->isPipeOutClient(clientFd)) {
-            return (it);
-        }
+void WebServer::reapProcesses() {
+    std::vector<Client*> notified;
+    reaper.reap(notified);
+    for (std::vector<Client*>::iterator it = notified.begin(); it != notified.end(); ++it) {
+        (*it)->updateEvents(*eventLoop);
+        (*it)->updateTimers(timers);
     }
+}
 
-    throw std::runtime_error("Client with fd " + numberToString(clientFd) + " not found");
+void WebServer::handleTimeout(const Timer& timer, std::vector<int>& fdsToRemove) {
+    const FdEntry& entry = registry.get(timer.getFd());
+
+    if (entry.role == FD_SIGNAL) {
+        reaper.processTimeout();
+        return;
+    }
+    if (entry.role != FD_CLIENT) {
+        logger.warn() << "Timeout on unknown fd " << timer.getFd() << std::endl;
+        return;
+    }
+    entry.server->processTimeout(timer, fdsToRemove, *eventLoop, registry, timers);
 }
 
 void WebServer::finishServers() {
     for (std::vector<ServerManager>::iterator it = servers.begin(); it != servers.end(); ++it) {
         std::vector<int> allSocketFd = (*it).finishServer();
 
-        for (std::vector<struct pollfd>::iterator it = fds.begin(); it != fds.end(); ++it) {
-            if (std::find(allSocketFd.begin(), allSocketFd.end(), (*it).fd) != allSocketFd.end()) {
-                fds.erase(it);
-            }
+        if (eventLoop == NULL) {
+            continue;
+        }
+        for (std::vector<int>::iterator fd = allSocketFd.begin(); fd != allSocketFd.end(); ++fd) {
+            registry.remove(*fd);
+            eventLoop->unwatch(*fd);
         }
     }
 }
@@ -190,21 +211,11 @@ void WebServer::verifyDuplicatedServers(std::vector<ServerConfig> serversConfig)
     }
 }
 
-std::vector<ServerManager>::iterator WebServer::findServerFd(int fd) {
-    for (std::vector<ServerManager>::iterator it = servers.begin(); it != servers.end(); ++it) {
-        if (it->getFd() == fd) {
-            return (it);
-        }
-    }
-    return (servers.end());
-}
-
 void WebServer::removeClient(int clientfd) {
-    for (std::vector<struct pollfd>::iterator it = fds.begin(); it != fds.end(); ++it) {
-        if ((*it).fd == clientfd) {
-            fds.erase(it);
-            close(clientfd);
-            break;
-        }
+    if (clientfd <= 0) {
+        return;
     }
+    registry.remove(clientfd);
+    eventLoop->unwatch(clientfd);
+    close(clientfd);
 }
@@ -0,0 +1,179 @@
+#include "CharTable.hpp"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const size_t CharTable::MAX_VECTOR_CHARACTERS = 4;
+const size_t CharTable::MAX_VECTOR_RANGES = 8;
+
+CharTable::CharTable() : size(0), rangeCount(0) {
+    std::fill(table, table + 256, false);
+    std::fill(characters, characters + MAX_VECTOR_CHARACTERS, '\0');
+    std::fill(rangeStarts, rangeStarts + MAX_VECTOR_RANGES, 0);
+    std::fill(rangeSpans, rangeSpans + MAX_VECTOR_RANGES, 0);
+}
+
+CharTable::CharTable(const std::string &characters) {
+    std::fill(table, table + 256, false);
+    std::fill(this->characters, this->characters + MAX_VECTOR_CHARACTERS, '\0');
+    size = 0;
+    for (size_t i = 0; i < characters.size(); ++i) {
+        unsigned char c = characters[i];
+        if (table[c]) {
+            continue;
+        }
+        table[c] = true;
+        if (size < MAX_VECTOR_CHARACTERS) {
+            this->characters[size] = c;
+        }
+        size++;
+    }
+    buildRanges();
+}
+
+CharTable::CharTable(const CharTable &other) {
+    *this = other;
+}
+
+CharTable &CharTable::operator=(const CharTable &other) {
+    if (this != &other) {
+        std::copy(other.table, other.table + 256, table);
+        std::copy(other.characters, other.characters + MAX_VECTOR_CHARACTERS, characters);
+        size = other.size;
+        std::copy(other.rangeStarts, other.rangeStarts + MAX_VECTOR_RANGES, rangeStarts);
+        std::copy(other.rangeSpans, other.rangeSpans + MAX_VECTOR_RANGES, rangeSpans);
+        rangeCount = other.rangeCount;
+    }
+    return (*this);
+}
+
+CharTable::~CharTable() {}
+
+// Past MAX_VECTOR_RANGES only the count goes on, the vector path is then left out
+void CharTable::buildRanges() {
+    std::fill(rangeStarts, rangeStarts + MAX_VECTOR_RANGES, 0);
+    std::fill(rangeSpans, rangeSpans + MAX_VECTOR_RANGES, 0);
+    rangeCount = 0;
+    for (size_t c = 0; c < 256; ++c) {
+        if (!table[c] || (c > 0 && table[c - 1])) {
+            continue;
+        }
+        size_t end = c;
+        while (end + 1 < 256 && table[end + 1]) {
+            ++end;
+        }
+        if (rangeCount < MAX_VECTOR_RANGES) {
+            rangeStarts[rangeCount] = c;
+            rangeSpans[rangeCount] = end - c;
+        }
+        rangeCount++;
+    }
+}
+
+bool CharTable::contains(unsigned char c) const {
+    return (table[c]);
+}
+
+size_t CharTable::find(const std::string &str, size_t pos) const {
+    if (pos >= str.size()) {
+        return (std::string::npos);
+    }
+
+    const char *data = str.data();
+    size_t length = str.size();
+    if (size > 0 && size <= MAX_VECTOR_CHARACTERS) {
+        pos += findVector(data + pos, length - pos);
+    }
+
+    for (; pos < length; ++pos) {
+        if (table[static_cast<unsigned char>(data[pos])]) {
+            return (pos);
+        }
+    }
+    return (std::string::npos);
+}
+
+size_t CharTable::findFirstNotOf(const std::string &str, size_t pos) const {
+    if (pos >= str.size()) {
+        return (std::string::npos);
+    }
+
+    size_t offset = findFirstNotOf(str.data() + pos, str.size() - pos);
+    return (offset == std::string::npos ? offset : pos + offset);
+}
+
+size_t CharTable::findFirstNotOf(const char *data, size_t length) const {
+    size_t i = 0;
+    if (rangeCount > 0 && rangeCount <= MAX_VECTOR_RANGES) {
+        i = findNotInRangesVector(data, length);
+    }
+
+    for (; i < length; ++i) {
+        if (!table[static_cast<unsigned char>(data[i])]) {
+            return (i);
+        }
+    }
+    return (std::string::npos);
+}
+
+// Skips whole blocks without a match, the scalar loop finishes from the returned offset
+size_t CharTable::findVector(const char *data, size_t length) const {
+    size_t offset = 0;
+
+#ifdef __SSE2__
+    __m128i needles[4];
+    for (size_t i = 0; i < size; ++i) {
+        needles[i] = _mm_set1_epi8(characters[i]);
+    }
+
+    for (; offset + 16 <= length; offset += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + offset));
+        __m128i matches = _mm_cmpeq_epi8(block, needles[0]);
+        for (size_t i = 1; i < size; ++i) {
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi8(block, needles[i]));
+        }
+        int mask = _mm_movemask_epi8(matches);
+        if (mask != 0) {
+            return (offset + __builtin_ctz(mask));
+        }
+    }
+#else
+    (void)data;
+    (void)length;
+#endif
+    return (offset);
+}
+
+// A byte is in a range when its distance from the start, taken as unsigned, is at most the span
+size_t CharTable::findNotInRangesVector(const char *data, size_t length) const {
+    size_t offset = 0;
+
+#ifdef __SSE2__
+    __m128i starts[8];
+    __m128i spans[8];
+    for (size_t i = 0; i < rangeCount; ++i) {
+        starts[i] = _mm_set1_epi8(rangeStarts[i]);
+        spans[i] = _mm_set1_epi8(rangeSpans[i]);
+    }
+
+    for (; offset + 16 <= length; offset += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + offset));
+        __m128i inside = _mm_setzero_si128();
+        for (size_t i = 0; i < rangeCount; ++i) {
+            __m128i distance = _mm_sub_epi8(block, starts[i]);
+            inside = _mm_or_si128(inside, _mm_cmpeq_epi8(_mm_min_epu8(distance, spans[i]), distance));
+        }
+        int mask = ~_mm_movemask_epi8(inside) & 0xFFFF;
+        if (mask != 0) {
+            return (offset + __builtin_ctz(mask));
+        }
+    }
+#else
+    (void)data;
+    (void)length;
+#endif
+    return (offset);
+}
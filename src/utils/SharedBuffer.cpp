@@ -0,0 +1,49 @@
+#include "SharedBuffer.hpp"
+
+SharedBuffer::SharedBuffer() : block(NULL) {}
+
+SharedBuffer::SharedBuffer(std::string &data) : block(new Block()) {
+    block->data.swap(data);
+    block->references = 1;
+}
+
+SharedBuffer::SharedBuffer(const SharedBuffer &other) : block(other.block) {
+    if (block != NULL) {
+        block->references++;
+    }
+}
+
+SharedBuffer &SharedBuffer::operator=(const SharedBuffer &other) {
+    if (block != other.block) {
+        release();
+        block = other.block;
+        if (block != NULL) {
+            block->references++;
+        }
+    }
+    return (*this);
+}
+
+SharedBuffer::~SharedBuffer() {
+    release();
+}
+
+const std::string &SharedBuffer::get() const {
+    static const std::string empty;
+    return (block != NULL ? block->data : empty);
+}
+
+size_t SharedBuffer::size() const {
+    return (block != NULL ? block->data.size() : 0);
+}
+
+bool SharedBuffer::empty() const {
+    return (size() == 0);
+}
+
+void SharedBuffer::release() {
+    if (block != NULL && --block->references == 0) {
+        delete block;
+    }
+    block = NULL;
+}
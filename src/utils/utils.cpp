@@ -1,5 +1,8 @@
 #include "utils.h"
 
+#include <sys/time.h>
+#include <zlib.h>
+
 #include <sstream>
 
 void removeUnecessarySpaces(std::string &fileString) {
@@ -97,3 +100,61 @@ void lowercase(std::string &str) {
         str[i] = std::tolower(str[i]);
     }
 }
+
+long long getCurrentTimeMillis() {
+    struct timeval time;
+    gettimeofday(&time, NULL);
+    return (time.tv_sec * 1000LL) + (time.tv_usec / 1000);
+}
+
+// Two writes within the same second differ only here, zero where the platform doesn't expose it
+long getMtimeNsec(const struct stat &info) {
+#ifdef __linux__
+    return (info.st_mtim.tv_nsec);
+#else
+    (void)info;
+    return (0);
+#endif
+}
+
+std::string formatHttpDate(time_t time) {
+    char buffer[64];
+    std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", std::gmtime(&time));
+    return (buffer);
+}
+
+// Accepts the preferred format and the two obsolete ones a recipient must still understand
+bool parseHttpDate(const std::string &date, time_t &time) {
+    static const char *formats[] = {"%a, %d %b %Y %H:%M:%S GMT", "%A, %d-%b-%y %H:%M:%S GMT", "%a %b %e %H:%M:%S %Y"};
+
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+        struct tm parsed;
+        std::memset(&parsed, 0, sizeof(parsed));
+        const char *end = strptime(date.c_str(), formats[i], &parsed);
+        if (end != NULL && *end == '\0') {
+            time = timegm(&parsed);
+            return (time != -1);
+        }
+    }
+    return (false);
+}
+
+// A complete gzip member, false when zlib fails
+bool gzipCompress(const std::string &input, int level, std::string &output) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    // 16 added to the window bits asks for a gzip header and trailer instead of a zlib one
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return (false);
+    }
+
+    output.resize(deflateBound(&stream, input.size()));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    stream.avail_in = input.size();
+    stream.next_out = reinterpret_cast<Bytef *>(&output[0]);
+    stream.avail_out = output.size();
+    int result = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return (result == Z_STREAM_END);
+}